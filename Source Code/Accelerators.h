@@ -0,0 +1,236 @@
+#ifndef ACCELERATORS_H_
+#define ACCELERATORS_H_
+
+#include <cstdlib>
+#include <vector>
+
+#include "Vectors.h"
+#include "Objects.h"
+
+using namespace std;
+
+// These resolve cyclical inclusions.
+class Object;
+struct Intersection;
+struct Material;
+
+// These macros control how the bounding volume hierarchy is built.
+#define BVH_BINS 16  // The number of buckets used when estimating the surface area heuristic.
+#define BVH_MAX_LEAF 4  // Leaves are always split once they hold more than this many objects.
+#define BVH_TRAVERSAL_COST 1.0  // The cost of a box test relative to an object intersection test.
+#define BVH_STACK_SIZE 256  // Traversal stacks of up to this many entries are kept on the call stack, and deeper trees use the heap.
+#define BVH_WIDTH 4  // Rays traverse a collapsed tree whose nodes have up to this many children.
+#define BVH_BUILD_THREADS 0  // Hierarchies are built with this many threads, or with one per core when this is 0.
+#define BVH_PARALLEL_THRESHOLD 4096  // Ranges with fewer objects than this are always built on one thread.
+#define BVH_TASKS_PER_THREAD 4  // The top of the tree is split into about this many subtrees per thread.
+#define BVH_REBUILD_RATIO 1.5  // A refitted hierarchy is rebuilt once its estimated cost grows by this factor.
+
+// These macros control how the uniform grid is built.
+#define GRID_DENSITY 3  // The grid aims for about this many cells per object.
+#define GRID_MAX_RESOLUTION 256  // No axis is divided into more cells than this.
+#define GRID_MAILBOX 16  // Recently tested objects are remembered so that objects spanning several cells are only tested once.
+#define GRID_MAX_HITS 32  // This many partially transparent objects hit by a shadow ray are remembered without allocating.
+
+// These macros control how the objects in a hierarchy's leaves are tested.
+#define LEAF_BLOCK_SIZE 4  // Leaves test one ray against blocks of up to this many shapes of the same type at once.
+#define LEAF_SIMD 1  // Leaves are tested a block at a time with SSE when this is 1, and one object at a time when it is 0.
+
+// These identify the accelerators that can be selected from the scene file or the command line.
+#define ACCEL_BVH 0
+#define ACCEL_GRID 1
+
+// This is an axis-aligned bounding box.
+struct Bounds {
+  float min[3];
+  float max[3];
+};
+
+// Nodes are stored depth-first, so the left child of an interior node always directly follows it.
+struct BVH_node {
+  Bounds box;
+  int start;  // For leaves, this is the first object index. For interior nodes, it is the right child index.
+  int count;  // This is zero for interior nodes.
+};
+
+// The binary tree is collapsed into these four-wide nodes, which each fit in one 64-byte cache line.
+// Each child's box is stored as 8-bit steps of 2^exponent from the node's origin, rounded outward so that it still encloses the child.
+// The steps are grouped by axis so that a ray can be tested against all four children at once.
+struct alignas(64) BVH4_node {
+  float origin[3];
+  signed char exponent[3];
+  unsigned char child_count;
+  unsigned char lower[3][BVH_WIDTH];
+  unsigned char upper[3][BVH_WIDTH];
+  int child[BVH_WIDTH];  // For leaves, this is the first object index. For interior children, it is a wide node index.
+  unsigned char count[BVH_WIDTH];  // This is zero for interior children.
+};
+
+// This holds the bounds and centroid of each object while the hierarchy is being built.
+struct BVH_primitive {
+  Bounds box;
+  float centroid[3];
+  int index;
+};
+
+// A block holds up to LEAF_BLOCK_SIZE shapes of one type from the same leaf, with each field of every shape side by side.
+// Spheres use the first four rows for their centers and radii, ellipsoids use six for their centers and radii, and
+// triangles use all nine for their first corners and two edges. Unused lanes repeat the first shape.
+struct alignas(16) Primitive_block {
+  float rows[9][LEAF_BLOCK_SIZE];
+  int first;  // This is the pool index of the block's first object.
+  unsigned char type;
+  unsigned char count;
+};
+
+// A primitive pool holds an accelerator's objects in the order that it tests them. Spheres, ellipsoids, and triangles
+// are copied into separate arrays for each of their fields, so a leaf can be tested with a switch on each object's type
+// instead of a virtual call. Other objects, such as instances, are still tested through their virtual functions.
+class Primitive_pool {
+  private:
+    vector<Object*> objects;
+    vector<unsigned char> types;
+    vector<int> slots;  // This is each object's position in the arrays for its type.
+    vector<int> materials;  // This is each object's index into the pool's material table.
+    vector<float> opacities;
+    vector<Material*> material_table;
+
+    vector<Vec3> sphere_centers;
+    vector<float> sphere_radii;
+
+    vector<Vec3> ellipsoid_centers;
+    vector<Vec3> ellipsoid_radii;
+
+    vector<Vec3> triangle_corners;
+    vector<Vec3> triangle_edges1;
+    vector<Vec3> triangle_edges2;
+
+    vector<Primitive_block> blocks;  // These are only made for hierarchies, whose leaves hold runs of objects.
+    vector<int> object_blocks;  // This is the block holding each object, followed by the number of blocks.
+
+    void copy_shapes();
+    void fill_blocks();
+
+  public:
+    void assign(vector<Object*> &pool_objects);
+    void make_blocks(vector<int> &leaf_starts);
+    void update();
+
+    int size() {return (int)objects.size();}
+    bool empty() {return objects.empty();}
+    Object *object(int i) {return objects[i];}
+    vector<Object*> &object_list() {return objects;}
+    float opacity(int i) {return opacities[materials[i]];}
+    size_t memory_usage();
+
+    // This tests the object at index i, and records a hit in the same way as the object's own ray_intersect.
+    inline bool intersect(int i, const Ray &ray, float tmax, Intersection &hit);
+    // This tests the object at index i against the rays of a packet whose bits are set in mask, and returns a mask of
+    // the rays that hit it. Their hits are recorded in the same way as by intersect.
+    inline int intersect_packet(int i, const Ray_packet &packet, int mask, const float (&tmax)[PACKET_SIZE],
+                                Intersection (&hits)[PACKET_SIZE]);
+    // This returns the fraction of a shadow ray's light that passes the object at index i before tmax.
+    inline float transmission(int i, const Ray &ray, float tmax);
+    // This does the same for the rays of a packet whose bits are set in mask, and returns a mask of the rays that the
+    // object dimmed.
+    inline int transmission_packet(int i, const Ray_packet &packet, int mask, const float (&tmax)[PACKET_SIZE],
+                                   float (&passed)[PACKET_SIZE]);
+    // These find the blocks that hold the objects in [start, end), which must be a run of whole leaves.
+    int first_block(int start) {return object_blocks[start];}
+    int end_block(int end) {return object_blocks[end];}
+    // This tests every object of a block in order, just as intersect would, and returns the index of the closest one
+    // hit before closest_t, which is then updated along with the hit. It returns -1 if nothing is hit.
+    inline int closest_in_block(int b, const Ray &ray, float &closest_t, Intersection &hit);
+    // This dims a shadow ray by every object of a block that it hits. It returns true once the ray is fully blocked,
+    // with the blocking object stored in blocker if that isn't NULL.
+    inline bool occlude_in_block(int b, const Ray &ray, float tmax, float &pass, Object **blocker);
+};
+
+int build_threads();
+void empty_bounds(Bounds &box);
+void grow_bounds(Bounds &box, Bounds &other);
+float surface_area(Bounds &box);
+
+// This is the base class for the structures that speed up ray queries against the scene's objects.
+// Queries never change the accelerator, so any number of rendering threads may share one.
+class Accelerator {
+  public:
+    virtual ~Accelerator () {}
+
+    // This returns the closest object hit by a ray that is nearer than closest_t, which is then updated along with its hit.
+    virtual Object *closest_intersection(const Ray &ray, float &closest_t, Intersection &hit) = 0;
+    // This returns the fraction of light that passes every object between a ray's origin and tmax.
+    // If an opaque object blocks the ray and blocker isn't NULL, that object is stored in it.
+    virtual float occlusion(const Ray &ray, float tmax, Object **blocker = NULL) = 0;
+    // These answer the same queries for the rays of a packet whose bits are set in mask, and each ray gets the same
+    // answer that it would get alone. The closest hits are returned as a mask of the rays that hit anything.
+    // Accelerators without their own packet traversal answer them one ray at a time.
+    virtual int closest_intersection_packet(const Ray_packet &packet, int mask, float (&closest_t)[PACKET_SIZE],
+                                            Intersection (&hits)[PACKET_SIZE], Object *(&objects)[PACKET_SIZE]);
+    virtual void occlusion_packet(const Ray_packet &packet, int mask, const float (&tmax)[PACKET_SIZE],
+                                  float (&pass)[PACKET_SIZE], Object *(&blockers)[PACKET_SIZE]);
+    // This brings the accelerator up to date after objects have moved. It returns true if it was rebuilt from scratch.
+    virtual bool update() = 0;
+    // This returns the number of bytes that the accelerator holds.
+    virtual size_t memory_usage() = 0;
+};
+
+// This is a bounding volume hierarchy built with the surface area heuristic.
+class BVH : public Accelerator {
+  private:
+    Primitive_pool pool;  // The objects are kept in leaf order.
+    vector<BVH_node> nodes;
+    vector<BVH4_node> wide_nodes;
+    float build_cost;
+    int stack_needed;  // This is the most entries that a traversal stack can hold, which is found while collapsing.
+    int threads_used;  // This is how many threads the last build used, since small scenes are built on one thread.
+
+    void build_hierarchy(vector<Object*> &scene_objects);
+    void build(vector<BVH_primitive> &primitives, int threads);
+    int collapse(int binary_index, int depth);
+
+  public:
+    BVH (vector<Object*> &scene_objects);
+
+    int node_count() {return (int)nodes.size();}
+    int wide_node_count() {return (int)wide_nodes.size();}
+    int build_thread_count() {return threads_used;}
+    void bounds(float (&min)[3], float (&max)[3]);
+    float cost();
+    void refit();
+
+    Object *closest_intersection(const Ray &ray, float &closest_t, Intersection &hit);
+    float occlusion(const Ray &ray, float tmax, Object **blocker = NULL);
+    int closest_intersection_packet(const Ray_packet &packet, int mask, float (&closest_t)[PACKET_SIZE],
+                                    Intersection (&hits)[PACKET_SIZE], Object *(&objects)[PACKET_SIZE]);
+    void occlusion_packet(const Ray_packet &packet, int mask, const float (&tmax)[PACKET_SIZE],
+                          float (&pass)[PACKET_SIZE], Object *(&blockers)[PACKET_SIZE]);
+    bool update();
+    size_t memory_usage();
+    int crossings(const Ray &ray, float tmax, int limit);
+};
+
+// This is a uniform grid of cells that is traversed with a 3D digital differential analyzer.
+class Grid : public Accelerator {
+  private:
+    Primitive_pool pool;
+    Bounds box;
+    int resolution[3];
+    float cell_size[3];
+    vector<int> cell_starts;  // The objects overlapping cell c are cell_objects[cell_starts[c], cell_starts[c+1]).
+    vector<int> cell_objects;
+
+    void build();
+
+  public:
+    Grid (vector<Object*> &scene_objects);
+
+    int cell_count() {return resolution[0]*resolution[1]*resolution[2];}
+    int reference_count() {return (int)cell_objects.size();}
+
+    Object *closest_intersection(const Ray &ray, float &closest_t, Intersection &hit);
+    float occlusion(const Ray &ray, float tmax, Object **blocker = NULL);
+    bool update();
+    size_t memory_usage();
+};
+
+#endif
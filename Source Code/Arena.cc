@@ -0,0 +1,45 @@
+#include <cstdlib>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "Arena.h"
+
+using namespace std;
+
+// A new block is started whenever the current one can't fit an allocation. Allocations that are larger than a block,
+// such as big textures, get a block of their own.
+void *Arena::allocate (size_t size, size_t alignment) {
+  size_t padding = (alignment - (uintptr_t)next % alignment) % alignment;
+  if (next == NULL || padding + size > remaining) {
+    size_t block_size = max((size_t)ARENA_BLOCK_SIZE, size + alignment);
+    next = (char*)malloc(block_size);
+    if (next == NULL) {
+      throw bad_alloc();
+    }
+    blocks.push_back(next);
+    remaining = block_size;
+    reserved += block_size;
+    padding = (alignment - (uintptr_t)next % alignment) % alignment;
+  }
+
+  void *memory = next + padding;
+  next += padding + size;
+  remaining -= padding + size;
+  used += size;
+  high_water = max(high_water, reserved);
+  allocations++;
+  return memory;
+}
+
+// This function frees every block at once. The high-water mark is kept so that it can still be reported afterwards.
+void Arena::release () {
+  for (vector<char*>::iterator i = blocks.begin(); i != blocks.end(); ++i) {
+    free(*i);
+  }
+  blocks.clear();
+  next = NULL;
+  remaining = 0;
+  used = 0;
+  reserved = 0;
+}
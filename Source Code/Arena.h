@@ -0,0 +1,46 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+#define ARENA_BLOCK_SIZE (1 << 20)  // Arenas take memory from the system in blocks of at least this many bytes.
+
+// An arena hands out memory for data that lives as long as the scene, such as objects, lights, materials, and textures.
+// Each allocation only moves a pointer forward inside of the current block, and every block is freed at once when the
+// arena is released or destroyed. Destructors are never run, so only types that own no other memory are made in arenas.
+class Arena {
+  private:
+    vector<char*> blocks;
+    char *next;
+    size_t remaining;
+    size_t used;
+    size_t reserved;
+    size_t high_water;
+    long allocations;
+
+  public:
+    Arena () : next(NULL), remaining(0), used(0), reserved(0), high_water(0), allocations(0) {}
+    ~Arena () {release();}
+
+    void *allocate(size_t size, size_t alignment);
+    void release();
+
+    // This constructs an object of type T in the arena with the given constructor arguments.
+    template <class T, class... Args>
+    T *make (Args&&... args) {
+      return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    size_t bytes_used() {return used;}
+    size_t bytes_reserved() {return reserved;}
+    size_t high_water_mark() {return high_water;}
+    long allocation_count() {return allocations;}
+    int block_count() {return (int)blocks.size();}
+};
+
+#endif
@@ -1,118 +1,82 @@
-#include <cstdlib>
-#include <cmath>
-#include <ctime>
-#include <vector>
-
-#include "Lights.h"
-#include "Vectors.h"
-#include "Casting.h"
-
-using namespace std;
-
-float Att_light::illumination (Vector *normal, Vector * v, Intersection *intersection, float ko_d, float ko_s, float n, int rgb_index) {
-  Vector *l = NULL;
-  float attenuation = 1;
-  if (w == 0) { // For directional lights...
-    l = new Vector;
-    l->x = intersection->x;
-    l->y = intersection->y;
-    l->z = intersection->z;
-    l->xd = x;
-    l->yd = y;
-    l->zd = z;
-    l->distance = 0;
-    scale_vector(l, -1);
-    unit_vector(l);
-  }
-  else { // For point lights...
-    l = new_vector(intersection->x, intersection->y, intersection->z, Light::x, Light::y, Light::z);
-    unit_vector(l);
-    // Attenuation is calculated here.
-    attenuation = 1 / (c1 + c2*l->distance + c3*pow(l->distance, 2));
-  }
-
-  Vector *h = add_vectors(l, v);
-  unit_vector(h);
-
-  float n_dot_l = dot_product(normal, l);
-  float n_dot_h = dot_product(normal, h);
-  if (0 > n_dot_l) {
-    n_dot_l = 0;
-  }
-  if (0 > n_dot_h) {
-    n_dot_h = 0;
-  }
-
-  delete l;
-  delete h;
-  return attenuation*Light::rgb[rgb_index]*(ko_d*n_dot_l + ko_s*pow(n_dot_h, n));
-}
-
-
-float Att_light::shadow(Intersection *intersection, vector<Object*> &objects, Vector *normal) {
-  float shadow_constant = 0;
-  int ray_iterations = 1;
-  float ray_passes = 0;
-
-  float x_bias = (normal->xd*SHADOW_BIAS);
-  float y_bias = (normal->yd*SHADOW_BIAS);
-  float z_bias = (normal->zd*SHADOW_BIAS);
-
-  if (SOFT_SHADOWS) {
-    ray_iterations = MAX_SHADOW_RAYS;
-  }
-
-  srand(time(NULL));
-
-  for (int i = 0; i < ray_iterations; i++) {
-    float x_copy = Light::x;
-    float y_copy = Light::y;
-    float z_copy = Light::z;
-
-    if (SOFT_SHADOWS) {
-      //For each loop, the target is adjusted randomly in order to help create softer shadows (if enabled).
-      x_copy += OFFSET_MIN + (rand() / (RAND_MAX / (OFFSET_MAX - OFFSET_MIN)));
-      y_copy += OFFSET_MIN + (rand() / (RAND_MAX / (OFFSET_MAX - OFFSET_MIN)));
-      z_copy += OFFSET_MIN + (rand() / (RAND_MAX / (OFFSET_MAX - OFFSET_MIN)));
-    }
-
-    Vector *shadow_ray = NULL;
-    if (w == 0) {
-      shadow_ray = new Vector;
-      shadow_ray->x = intersection->x + x_bias;
-      shadow_ray->y = intersection->y + y_bias;
-      shadow_ray->z = intersection->z + z_bias;
-      shadow_ray->xd = Light::x;
-      shadow_ray->yd = Light::y;
-      shadow_ray->zd = Light::z;
-      shadow_ray->distance = 0;
-      scale_vector(shadow_ray, -1);
-      unit_vector(shadow_ray);
-    }
-    else {
-      shadow_ray = new_vector(intersection->x + x_bias, intersection->y + y_bias, intersection->z + z_bias, x_copy, y_copy, z_copy);
-      unit_vector(shadow_ray);
-    }
-
-    float pass = 1;
-    for (vector<Object*>::iterator i = objects.begin(); i != objects.end(); ++i) {
-      Intersection *contact = (*i)->ray_intersect(shadow_ray);
-
-      if (w == 0) { // For directional lights...
-        if (contact->distance > 0) {
-          pass = pass*(1 - (*i)->get_material()->opacity);
-        }
-      }
-      else { // For point lights...
-        if (contact->distance > 0 && contact->distance < shadow_ray->distance) {
-          pass = pass*(1 - (*i)->get_material()->opacity);
-        }
-      }
-      delete contact;
-    }
-    ray_passes += pass;
-    delete shadow_ray;
-  }
-  shadow_constant = ray_passes/ray_iterations;
-  return shadow_constant;
-}
+#include <cstdlib>
+#include <cmath>
+#include <cfloat>
+#include <vector>
+
+#include "Lights.h"
+#include "Vectors.h"
+#include "Casting.h"
+#include "Accelerators.h"
+
+using namespace std;
+
+float Att_light::illumination (const Intersection &hit, Vec3 v, float ko_d, float ko_s, float n, int rgb_index) {
+  Vec3 l;
+  float attenuation = 1;
+  if (w == 0) { // For directional lights...
+    l = unit_vector(-position());
+  }
+  else { // For point lights...
+    Vec3 to_light = position() - hit.point;
+    float distance = vector_length(to_light);
+    l = to_light*(1/distance);
+    // Attenuation is calculated here.
+    attenuation = 1 / (c1 + c2*distance + c3*pow(distance, 2));
+  }
+
+  Vec3 h = unit_vector(l + v);
+
+  float n_dot_l = dot_product(hit.normal, l);
+  float n_dot_h = dot_product(hit.normal, h);
+  if (0 > n_dot_l) {
+    n_dot_l = 0;
+  }
+  if (0 > n_dot_h) {
+    n_dot_h = 0;
+  }
+
+  return attenuation*Light::rgb[rgb_index]*(ko_d*n_dot_l + ko_s*pow(n_dot_h, n));
+}
+
+
+int Att_light::shadow_rays (const Intersection &hit, const Random_key &key, unsigned int index, unsigned int sample, Ray *rays, float *distances, float &ray_passes) {
+  int ray_iterations = shadow_ray_count();
+  int traced = 0;
+
+  Vec3 origin = hit.point + hit.geometric_normal*SHADOW_BIAS;
+
+  for (int i = 0; i < ray_iterations; i++) {
+    Vec3 target = position();
+
+    if (SOFT_SHADOWS) {
+      //For each loop, the target is adjusted randomly in order to help create softer shadows (if enabled).
+      target.x += OFFSET_MIN + random_number(key, index, 3*(sample*ray_iterations + i) + 0)*(OFFSET_MAX - OFFSET_MIN);
+      target.y += OFFSET_MIN + random_number(key, index, 3*(sample*ray_iterations + i) + 1)*(OFFSET_MAX - OFFSET_MIN);
+      target.z += OFFSET_MIN + random_number(key, index, 3*(sample*ray_iterations + i) + 2)*(OFFSET_MAX - OFFSET_MIN);
+    }
+
+    if (w == 0) { // For directional lights...
+      rays[traced] = Ray{origin, unit_vector(-position())};
+      distances[traced] = FLT_MAX;
+    }
+    else { // For point lights, only objects in front of the light can block it.
+      Vec3 to_light = target - origin;
+      float distance = vector_length(to_light);
+      rays[traced] = Ray{origin, to_light*(1/distance)};
+      distances[traced] = distance;
+    }
+    traced++;
+  }
+  return traced;
+}
+
+bool Att_light::bounds (Light_bounds &bounds) {
+  if (w == 0) {
+    return false;
+  }
+  point_bounds(bounds);
+  bounds.attenuation[0] = c1;
+  bounds.attenuation[1] = c2;
+  bounds.attenuation[2] = c3;
+  return true;
+}
@@ -0,0 +1,1110 @@
+#include <cstdlib>
+#include <cmath>
+#include <cfloat>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Accelerators.h"
+#include "Vectors.h"
+#include "Casting.h"
+#include "Objects.h"
+#include "Primitives.h"
+
+using namespace std;
+
+// This function resets a box so that growing it by any other box yields that box.
+void empty_bounds (Bounds &box) {
+  for (int i = 0; i < 3; i++) {
+    box.min[i] = FLT_MAX;
+    box.max[i] = -FLT_MAX;
+  }
+}
+
+// This function expands a box to enclose another box.
+void grow_bounds (Bounds &box, Bounds &other) {
+  for (int i = 0; i < 3; i++) {
+    box.min[i] = min(box.min[i], other.min[i]);
+    box.max[i] = max(box.max[i], other.max[i]);
+  }
+}
+
+// This function returns the surface area of a box, which estimates how often a random ray will hit it.
+float surface_area (Bounds &box) {
+  float dx = box.max[0] - box.min[0];
+  float dy = box.max[1] - box.min[1];
+  float dz = box.max[2] - box.min[2];
+  if (dx < 0 || dy < 0 || dz < 0) {
+    return 0;
+  }
+  return 2*(dx*dy + dy*dz + dz*dx);
+}
+
+// Accelerators without their own packet traversal trace each ray of a packet alone.
+int Accelerator::closest_intersection_packet (const Ray_packet &packet, int mask, float (&closest_t)[PACKET_SIZE],
+                                              Intersection (&hits)[PACKET_SIZE], Object *(&objects)[PACKET_SIZE]) {
+  int hit_mask = 0;
+  for (int lane = 0; lane < PACKET_SIZE; lane++) {
+    objects[lane] = NULL;
+    if (mask & (1 << lane)) {
+      objects[lane] = closest_intersection(packet.rays[lane], closest_t[lane], hits[lane]);
+      if (objects[lane] != NULL) {
+        hit_mask |= 1 << lane;
+      }
+    }
+  }
+  return hit_mask;
+}
+
+void Accelerator::occlusion_packet (const Ray_packet &packet, int mask, const float (&tmax)[PACKET_SIZE],
+                                    float (&pass)[PACKET_SIZE], Object *(&blockers)[PACKET_SIZE]) {
+  for (int lane = 0; lane < PACKET_SIZE; lane++) {
+    pass[lane] = 1;
+    blockers[lane] = NULL;
+    if (mask & (1 << lane)) {
+      pass[lane] = occlusion(packet.rays[lane], tmax[lane], &blockers[lane]);
+    }
+  }
+}
+
+// This function returns the number of threads used to build hierarchies.
+int build_threads () {
+  int threads = BVH_BUILD_THREADS;
+  if (threads <= 0) {
+    threads = (int)thread::hardware_concurrency();
+  }
+  return max(threads, 1);
+}
+
+// This function splits [start, end) into one chunk per thread and runs work(chunk, first, last) on each chunk at once.
+template <typename Work>
+static void parallel_for (int start, int end, int threads, Work work) {
+  if (threads <= 1) {
+    work(0, start, end);
+    return;
+  }
+  vector<thread> workers;
+  for (int t = 0; t < threads; t++) {
+    int first = start + (int)((long)(end - start)*t/threads);
+    int last = start + (int)((long)(end - start)*(t + 1)/threads);
+    workers.push_back(thread(work, t, first, last));
+  }
+  for (unsigned int t = 0; t < workers.size(); t++) {
+    workers[t].join();
+  }
+}
+
+// The hierarchy is built once from the scene's objects, which are copied into leaf order.
+BVH::BVH (vector<Object*> &scene_objects) {
+  build_hierarchy(scene_objects);
+}
+
+// This function builds the hierarchy from scratch and records its cost for later comparison with refitted trees.
+void BVH::build_hierarchy (vector<Object*> &scene_objects) {
+  int threads = build_threads();
+  vector<BVH_primitive> primitives(scene_objects.size());
+  if (primitives.size() < 2*BVH_PARALLEL_THRESHOLD) {
+    threads = 1;
+  }
+  threads_used = threads;
+  parallel_for(0, (int)primitives.size(), threads, [&](int chunk, int first, int last) {
+    for (int i = first; i < last; i++) {
+      scene_objects[i]->bounds(primitives[i].box.min, primitives[i].box.max);
+      for (int axis = 0; axis < 3; axis++) {
+        primitives[i].centroid[axis] = 0.5*(primitives[i].box.min[axis] + primitives[i].box.max[axis]);
+      }
+      primitives[i].index = i;
+    }
+  });
+
+  nodes.clear();
+  wide_nodes.clear();
+  build_cost = 0;
+  stack_needed = 0;
+  if (primitives.empty()) {
+    pool.assign(scene_objects);
+    vector<int> leaf_starts;
+    pool.make_blocks(leaf_starts);
+    return;
+  }
+
+  nodes.reserve(2*primitives.size());
+  build(primitives, threads);
+
+  vector<Object*> leaf_objects;
+  leaf_objects.reserve(primitives.size());
+  for (unsigned int i = 0; i < primitives.size(); i++) {
+    leaf_objects.push_back(scene_objects[primitives[i].index]);
+  }
+  pool.assign(leaf_objects);
+  vector<int> leaf_starts;
+  for (unsigned int i = 0; i < nodes.size(); i++) {
+    if (nodes[i].count > 0) {
+      leaf_starts.push_back(nodes[i].start);
+    }
+  }
+  pool.make_blocks(leaf_starts);
+  build_cost = cost();
+  collapse(0, 1);
+}
+
+// This function returns the surface area heuristic's estimate of the cost of tracing a ray through the tree.
+float BVH::cost () {
+  if (nodes.empty()) {
+    return 0;
+  }
+  float root_area = surface_area(nodes[0].box);
+  if (root_area <= 0) {
+    return 0;
+  }
+  float total = 0;
+  for (unsigned int i = 0; i < nodes.size(); i++) {
+    float weight = nodes[i].count > 0 ? nodes[i].count : BVH_TRAVERSAL_COST;
+    total += weight*surface_area(nodes[i].box)/root_area;
+  }
+  return total;
+}
+
+// Since children are always stored after their parents, walking the nodes backwards refits every child before its parent.
+// The boxes are found from the objects themselves, so the pool's copies of the shapes are refreshed afterwards.
+void BVH::refit () {
+  for (int i = (int)nodes.size() - 1; i >= 0; i--) {
+    BVH_node &node = nodes[i];
+    if (node.count > 0) {
+      empty_bounds(node.box);
+      for (int j = node.start; j < node.start + node.count; j++) {
+        Bounds object_box;
+        pool.object(j)->bounds(object_box.min, object_box.max);
+        grow_bounds(node.box, object_box);
+      }
+    }
+    else {
+      node.box = nodes[i + 1].box;
+      grow_bounds(node.box, nodes[node.start].box);
+    }
+  }
+}
+
+// Moved objects are usually handled by refitting, which keeps the tree's shape.
+// If the objects have moved far enough that the refitted tree costs much more than a fresh one would, it is rebuilt.
+// The wide nodes are collapsed again afterwards, which also takes linear time. A rebuild fills the pool again, so the
+// pool's shapes are only refreshed when the refitted tree is kept.
+bool BVH::update () {
+  refit();
+  if (cost() > BVH_REBUILD_RATIO*build_cost) {
+    vector<Object*> scene_objects(pool.object_list());
+    build_hierarchy(scene_objects);
+    return true;
+  }
+  pool.update();
+  wide_nodes.clear();
+  stack_needed = 0;
+  if (!nodes.empty()) {
+    collapse(0, 1);
+  }
+  return false;
+}
+
+// This function returns the number of bytes held by the hierarchy's nodes and primitive pool.
+size_t BVH::memory_usage () {
+  return nodes.capacity()*sizeof(BVH_node) + wide_nodes.capacity()*sizeof(BVH4_node) + pool.memory_usage();
+}
+
+// This function returns the box around everything in the hierarchy.
+void BVH::bounds (float (&min)[3], float (&max)[3]) {
+  for (int axis = 0; axis < 3; axis++) {
+    min[axis] = nodes.empty() ? 0 : nodes[0].box.min[axis];
+    max[axis] = nodes.empty() ? 0 : nodes[0].box.max[axis];
+  }
+}
+
+// This holds the bounds of a range of primitives and the best way found to split it.
+struct BVH_split {
+  Bounds box;
+  Bounds centroid_box;
+  int axis;  // This is -1 when the centroids can't be separated.
+  int bin;
+  float cost;
+};
+
+// The centroids are sorted into buckets along each axis, and every bucket boundary is scored with the surface area heuristic.
+// Large ranges are binned by several threads, each filling its own buckets, which are then merged.
+static void find_split (vector<BVH_primitive> &primitives, int start, int end, int threads, BVH_split &split) {
+  threads = max(1, min(threads, (end - start)/BVH_PARALLEL_THRESHOLD));
+
+  vector<Bounds> chunk_boxes(2*threads);
+  parallel_for(start, end, threads, [&](int chunk, int first, int last) {
+    Bounds &box = chunk_boxes[2*chunk];
+    Bounds &centroid_box = chunk_boxes[2*chunk + 1];
+    empty_bounds(box);
+    empty_bounds(centroid_box);
+    for (int i = first; i < last; i++) {
+      grow_bounds(box, primitives[i].box);
+      for (int axis = 0; axis < 3; axis++) {
+        centroid_box.min[axis] = min(centroid_box.min[axis], primitives[i].centroid[axis]);
+        centroid_box.max[axis] = max(centroid_box.max[axis], primitives[i].centroid[axis]);
+      }
+    }
+  });
+  empty_bounds(split.box);
+  empty_bounds(split.centroid_box);
+  for (int t = 0; t < threads; t++) {
+    grow_bounds(split.box, chunk_boxes[2*t]);
+    grow_bounds(split.centroid_box, chunk_boxes[2*t + 1]);
+  }
+
+  split.axis = -1;
+  split.bin = 0;
+  split.cost = FLT_MAX;
+  if (end - start == 1) {
+    return;
+  }
+
+  Bounds &centroid_box = split.centroid_box;
+  vector<Bounds> bin_boxes(threads*3*BVH_BINS);
+  vector<int> bin_counts(threads*3*BVH_BINS, 0);
+  parallel_for(start, end, threads, [&](int chunk, int first, int last) {
+    Bounds *boxes = &bin_boxes[chunk*3*BVH_BINS];
+    int *counts = &bin_counts[chunk*3*BVH_BINS];
+    for (int b = 0; b < 3*BVH_BINS; b++) {
+      empty_bounds(boxes[b]);
+    }
+    for (int axis = 0; axis < 3; axis++) {
+      float extent = centroid_box.max[axis] - centroid_box.min[axis];
+      if (extent <= 0) {
+        continue;
+      }
+      for (int i = first; i < last; i++) {
+        int b = (int)(BVH_BINS*(primitives[i].centroid[axis] - centroid_box.min[axis])/extent);
+        b = axis*BVH_BINS + min(b, BVH_BINS - 1);
+        counts[b]++;
+        grow_bounds(boxes[b], primitives[i].box);
+      }
+    }
+  });
+  for (int t = 1; t < threads; t++) {
+    for (int b = 0; b < 3*BVH_BINS; b++) {
+      grow_bounds(bin_boxes[b], bin_boxes[t*3*BVH_BINS + b]);
+      bin_counts[b] += bin_counts[t*3*BVH_BINS + b];
+    }
+  }
+
+  float parent_area = surface_area(split.box);
+  for (int axis = 0; axis < 3; axis++) {
+    if (centroid_box.max[axis] - centroid_box.min[axis] <= 0) {
+      continue;
+    }
+    Bounds *boxes = &bin_boxes[axis*BVH_BINS];
+    int *counts = &bin_counts[axis*BVH_BINS];
+
+    // The areas to the right of every boundary are swept first so that each split is scored in a single pass.
+    float right_areas[BVH_BINS];
+    int right_counts[BVH_BINS];
+    Bounds sweep;
+    empty_bounds(sweep);
+    int sweep_count = 0;
+    for (int b = BVH_BINS - 1; b > 0; b--) {
+      grow_bounds(sweep, boxes[b]);
+      sweep_count += counts[b];
+      right_areas[b] = surface_area(sweep);
+      right_counts[b] = sweep_count;
+    }
+
+    empty_bounds(sweep);
+    sweep_count = 0;
+    for (int b = 1; b < BVH_BINS; b++) {
+      grow_bounds(sweep, boxes[b - 1]);
+      sweep_count += counts[b - 1];
+      if (sweep_count == 0 || right_counts[b] == 0) {
+        continue;
+      }
+      float cost = BVH_TRAVERSAL_COST + (surface_area(sweep)*sweep_count + right_areas[b]*right_counts[b])/parent_area;
+      if (cost < split.cost) {
+        split.cost = cost;
+        split.axis = axis;
+        split.bin = b;
+      }
+    }
+  }
+}
+
+// A leaf is made when splitting would cost more than testing every object, or when the centroids can't be separated.
+// Objects with identical centroids are still split down the middle once there are too many of them for one leaf.
+static bool make_leaf (BVH_split &split, int count) {
+  if (count == 1) {
+    return true;
+  }
+  if (split.axis == -1) {
+    return count <= BVH_MAX_LEAF;
+  }
+  return split.cost >= count && count <= BVH_MAX_LEAF;
+}
+
+// This function reorders the primitives on either side of a split and returns the index of the first one on the right.
+static int split_range (vector<BVH_primitive> &primitives, int start, int end, BVH_split &split) {
+  if (split.axis == -1) {
+    return (start + end)/2;
+  }
+  int axis = split.axis;
+  int bin = split.bin;
+  float split_min = split.centroid_box.min[axis];
+  float split_extent = split.centroid_box.max[axis] - split_min;
+  BVH_primitive *middle = partition(&primitives[0] + start, &primitives[0] + end,
+                                    [=](BVH_primitive &primitive) {
+                                      int b = (int)(BVH_BINS*(primitive.centroid[axis] - split_min)/split_extent);
+                                      return min(b, BVH_BINS - 1) < bin;
+                                    });
+  return (int)(middle - &primitives[0]);
+}
+
+// This function recursively builds the node covering primitives[start, end) on one thread and returns its index.
+static int build_subtree (vector<BVH_primitive> &primitives, int start, int end, vector<BVH_node> &nodes) {
+  int node_index = (int)nodes.size();
+  nodes.push_back(BVH_node());
+
+  BVH_split split;
+  find_split(primitives, start, end, 1, split);
+  nodes[node_index].box = split.box;
+
+  int count = end - start;
+  if (make_leaf(split, count)) {
+    nodes[node_index].start = start;
+    nodes[node_index].count = count;
+    return node_index;
+  }
+
+  int middle = split_range(primitives, start, end, split);
+  build_subtree(primitives, start, middle, nodes);
+  nodes[node_index].start = build_subtree(primitives, middle, end, nodes);
+  nodes[node_index].count = 0;
+  return node_index;
+}
+
+// These hold the top of a hierarchy that is being built in parallel. Ranges that are small enough become tasks
+// that are each built on one thread, and their nodes are spliced into the hierarchy once every task has finished.
+struct BVH_top {
+  Bounds box;
+  int left;
+  int right;
+  int task;  // This is -1 for nodes that were split before the tasks were made.
+};
+
+struct BVH_task {
+  int start;
+  int end;
+  vector<BVH_node> nodes;
+};
+
+// The top nodes are split with every thread binning together, and each returns its index among the top nodes.
+static int build_top (vector<BVH_primitive> &primitives, int start, int end, int threads, int task_size,
+                      vector<BVH_top> &top, vector<BVH_task> &tasks) {
+  int top_index = (int)top.size();
+  top.push_back(BVH_top());
+  top[top_index].task = -1;
+
+  if (end - start <= task_size) {
+    top[top_index].task = (int)tasks.size();
+    tasks.push_back(BVH_task());
+    tasks.back().start = start;
+    tasks.back().end = end;
+    return top_index;
+  }
+
+  // Since tasks hold more than BVH_MAX_LEAF objects, these ranges are always split.
+  BVH_split split;
+  find_split(primitives, start, end, threads, split);
+  top[top_index].box = split.box;
+  int middle = split_range(primitives, start, end, split);
+  int left = build_top(primitives, start, middle, threads, task_size, top, tasks);
+  int right = build_top(primitives, middle, end, threads, task_size, top, tasks);
+  top[top_index].left = left;
+  top[top_index].right = right;
+  return top_index;
+}
+
+// The top nodes and the tasks' nodes are copied into the hierarchy in depth-first order, and the task's interior nodes
+// have their right child indices moved along with them.
+static int splice (vector<BVH_top> &top, vector<BVH_task> &tasks, int top_index, vector<BVH_node> &nodes) {
+  BVH_top &top_node = top[top_index];
+  if (top_node.task != -1) {
+    int offset = (int)nodes.size();
+    vector<BVH_node> &task_nodes = tasks[top_node.task].nodes;
+    for (unsigned int i = 0; i < task_nodes.size(); i++) {
+      nodes.push_back(task_nodes[i]);
+      if (nodes.back().count == 0) {
+        nodes.back().start += offset;
+      }
+    }
+    return offset;
+  }
+
+  int node_index = (int)nodes.size();
+  nodes.push_back(BVH_node());
+  nodes[node_index].box = top_node.box;
+  nodes[node_index].count = 0;
+  splice(top, tasks, top_node.left, nodes);
+  nodes[node_index].start = splice(top, tasks, top_node.right, nodes);
+  return node_index;
+}
+
+// Small scenes are built on one thread. Otherwise the top of the tree is split until there are several tasks for
+// every thread, and the threads take tasks from a shared counter, largest first, until none are left.
+// Every split is chosen the same way either way, so the hierarchy doesn't depend on the number of threads.
+void BVH::build (vector<BVH_primitive> &primitives, int threads) {
+  int count = (int)primitives.size();
+  if (threads <= 1 || count < 2*BVH_PARALLEL_THRESHOLD) {
+    build_subtree(primitives, 0, count, nodes);
+    return;
+  }
+
+  int task_size = max(BVH_PARALLEL_THRESHOLD, count/(BVH_TASKS_PER_THREAD*threads));
+  vector<BVH_top> top;
+  vector<BVH_task> tasks;
+  build_top(primitives, 0, count, threads, task_size, top, tasks);
+
+  vector<int> order(tasks.size());
+  for (unsigned int i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  sort(order.begin(), order.end(), [&](int a, int b) {
+    return tasks[a].end - tasks[a].start > tasks[b].end - tasks[b].start;
+  });
+
+  atomic<int> next_task(0);
+  parallel_for(0, threads, threads, [&](int chunk, int first, int last) {
+    for (int i = next_task++; i < (int)order.size(); i = next_task++) {
+      BVH_task &task = tasks[order[i]];
+      task.nodes.reserve(2*(task.end - task.start));
+      build_subtree(primitives, task.start, task.end, task.nodes);
+    }
+  });
+
+  splice(top, tasks, 0, nodes);
+}
+
+// This function returns 2^exponent by building the float's bits directly.
+static float exponent_scale (signed char exponent) {
+  int bits = (exponent + 127) << 23;
+  float scale;
+  memcpy(&scale, &bits, sizeof(scale));
+  return scale;
+}
+
+// This function stores a box as 8-bit steps from a wide node's origin. The steps are rounded outward and then checked
+// in single precision, so the stored box always encloses the original one.
+static void quantize_box (BVH4_node &node, int slot, Bounds &box) {
+  for (int axis = 0; axis < 3; axis++) {
+    float scale = exponent_scale(node.exponent[axis]);
+    int lower = (int)floor(((double)box.min[axis] - node.origin[axis])/scale);
+    int upper = (int)ceil(((double)box.max[axis] - node.origin[axis])/scale);
+    lower = max(0, min(lower, 255));
+    upper = max(0, min(upper, 255));
+    while (lower > 0 && node.origin[axis] + lower*scale > box.min[axis]) {
+      lower--;
+    }
+    while (upper < 255 && node.origin[axis] + upper*scale < box.max[axis]) {
+      upper++;
+    }
+    node.lower[axis][slot] = (unsigned char)lower;
+    node.upper[axis][slot] = (unsigned char)upper;
+  }
+}
+
+// Each wide node takes the place of up to two levels of the binary tree. The interior child with the largest
+// surface area is repeatedly replaced by its two children until the node is full. The wide node's index is returned.
+// Traversals leave at most BVH_WIDTH - 1 deferred children on their stacks for each level above the node that they
+// open, and opening the deepest one pushes all of its children, so the stack size needed is found from the depth.
+int BVH::collapse (int binary_index, int depth) {
+  int wide_index = (int)wide_nodes.size();
+  wide_nodes.push_back(BVH4_node());
+  stack_needed = max(stack_needed, (BVH_WIDTH - 1)*depth + 1);
+
+  int children[BVH_WIDTH];
+  int child_count = 0;
+  if (nodes[binary_index].count > 0) {
+    children[child_count++] = binary_index;
+  }
+  else {
+    children[child_count++] = binary_index + 1;
+    children[child_count++] = nodes[binary_index].start;
+  }
+  while (child_count < BVH_WIDTH) {
+    int largest = -1;
+    float largest_area = -1;
+    for (int i = 0; i < child_count; i++) {
+      BVH_node &child = nodes[children[i]];
+      if (child.count == 0 && surface_area(child.box) > largest_area) {
+        largest = i;
+        largest_area = surface_area(child.box);
+      }
+    }
+    if (largest == -1) {
+      break;
+    }
+    int opened = children[largest];
+    children[largest] = opened + 1;
+    children[child_count++] = nodes[opened].start;
+  }
+
+  // The steps on each axis are the smallest power of two that lets 255 of them span the node's box.
+  BVH4_node &node = wide_nodes[wide_index];
+  Bounds &box = nodes[binary_index].box;
+  node.child_count = (unsigned char)child_count;
+  for (int axis = 0; axis < 3; axis++) {
+    node.origin[axis] = box.min[axis];
+    int exponent;
+    frexp((box.max[axis] - box.min[axis])/255, &exponent);
+    exponent = max(-126, min(exponent, 127));
+    while (exponent < 127 && node.origin[axis] + 255*exponent_scale(exponent) < box.max[axis]) {
+      exponent++;
+    }
+    node.exponent[axis] = (signed char)exponent;
+  }
+  for (int i = 0; i < BVH_WIDTH; i++) {
+    // Unused slots get inverted boxes, which no ray can hit.
+    for (int axis = 0; axis < 3; axis++) {
+      node.lower[axis][i] = 255;
+      node.upper[axis][i] = 0;
+    }
+    node.child[i] = -1;
+    node.count[i] = 0;
+  }
+  for (int i = 0; i < child_count; i++) {
+    quantize_box(node, i, nodes[children[i]].box);
+  }
+
+  // The interior children are collapsed after the node is filled in, since adding nodes can move the vector.
+  for (int i = 0; i < child_count; i++) {
+    BVH_node &child = nodes[children[i]];
+    if (child.count > 0) {
+      wide_nodes[wide_index].child[i] = child.start;
+      wide_nodes[wide_index].count[i] = (unsigned char)child.count;
+    }
+    else {
+      int child_index = collapse(children[i], depth + 1);
+      wide_nodes[wide_index].child[i] = child_index;
+    }
+  }
+  return wide_index;
+}
+
+// This function returns a traversal stack that can hold as many entries as the hierarchy needs. The one on the call
+// stack is used unless the hierarchy is too deep for it.
+template <typename Entry>
+static Entry *traversal_stack (int needed, Entry (&fixed)[BVH_STACK_SIZE], vector<Entry> &spilled) {
+  if (needed <= BVH_STACK_SIZE) {
+    return fixed;
+  }
+  spilled.resize(needed);
+  return &spilled[0];
+}
+
+// This holds the parts of a ray that every box test needs, along with which face of each slab the ray enters first.
+struct BVH_ray {
+  float origin[3];
+  float inverse[3];
+  bool negative[3];
+};
+
+static void setup_ray (const Ray &ray, BVH_ray &setup) {
+  float direction[3] = {ray.direction.x, ray.direction.y, ray.direction.z};
+  setup.origin[0] = ray.origin.x;
+  setup.origin[1] = ray.origin.y;
+  setup.origin[2] = ray.origin.z;
+  for (int axis = 0; axis < 3; axis++) {
+    setup.inverse[axis] = 1/direction[axis];
+    setup.negative[axis] = setup.inverse[axis] < 0;
+  }
+}
+
+// Rounding in the slab distances could make a ray that grazes a box miss it, so the far distance is padded slightly.
+#define BVH_FAR_PADDING 1.0000004f
+
+#ifdef __SSE2__
+// This function widens four 8-bit steps into four floats.
+static inline __m128 load_steps (unsigned char (&steps)[BVH_WIDTH]) {
+  int packed;
+  memcpy(&packed, steps, sizeof(packed));
+  __m128i zero = _mm_setzero_si128();
+  __m128i wide = _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero);
+  return _mm_cvtepi32_ps(_mm_unpacklo_epi16(wide, zero));
+}
+#endif
+
+// This function tests a ray against every child of a wide node at once. It returns a bit mask of the children that are hit
+// before tmax and fills in their entry distances.
+static int child_entries (BVH4_node &node, BVH_ray &ray, float tmax, float (&t)[BVH_WIDTH]) {
+#ifdef __SSE2__
+  __m128 t_near = _mm_setzero_ps();
+  __m128 t_far = _mm_set1_ps(tmax);
+  for (int axis = 0; axis < 3; axis++) {
+    __m128 scale = _mm_set1_ps(exponent_scale(node.exponent[axis]));
+    __m128 offset = _mm_set1_ps(node.origin[axis] - ray.origin[axis]);
+    __m128 inverse = _mm_set1_ps(ray.inverse[axis]);
+    __m128 near_steps = load_steps(ray.negative[axis] ? node.upper[axis] : node.lower[axis]);
+    __m128 far_steps = load_steps(ray.negative[axis] ? node.lower[axis] : node.upper[axis]);
+    __m128 near_t = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(near_steps, scale), offset), inverse);
+    __m128 far_t = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(far_steps, scale), offset), inverse);
+    // When either operand is NaN, these return the second one, so rays lying on a slab plane fall through harmlessly.
+    t_near = _mm_max_ps(near_t, t_near);
+    t_far = _mm_min_ps(far_t, t_far);
+  }
+  t_far = _mm_mul_ps(t_far, _mm_set1_ps(BVH_FAR_PADDING));
+  _mm_storeu_ps(t, t_near);
+  return _mm_movemask_ps(_mm_cmple_ps(t_near, t_far)) & ((1 << node.child_count) - 1);
+#else
+  int mask = 0;
+  for (int i = 0; i < node.child_count; i++) {
+    float t_near = 0;
+    float t_far = tmax;
+    for (int axis = 0; axis < 3; axis++) {
+      float scale = exponent_scale(node.exponent[axis]);
+      float offset = node.origin[axis] - ray.origin[axis];
+      unsigned char near_step = ray.negative[axis] ? node.upper[axis][i] : node.lower[axis][i];
+      unsigned char far_step = ray.negative[axis] ? node.lower[axis][i] : node.upper[axis][i];
+      float near_t = (near_step*scale + offset)*ray.inverse[axis];
+      float far_t = (far_step*scale + offset)*ray.inverse[axis];
+      t_near = near_t > t_near ? near_t : t_near;
+      t_far = far_t < t_far ? far_t : t_far;
+    }
+    t[i] = t_near;
+    if (t_near <= t_far*BVH_FAR_PADDING) {
+      mask |= 1 << i;
+    }
+  }
+  return mask;
+#endif
+}
+
+// This is an entry on the traversal stack. Leaves are pushed like any other child so that they can be skipped by distance.
+struct BVH_entry {
+  int index;
+  int count;
+  float t;
+};
+
+// The children of each wide node are visited nearest first, and deferred children are skipped once a closer hit is found.
+Object *BVH::closest_intersection (const Ray &ray, float &closest_t, Intersection &hit) {
+  Object *closest_object = NULL;
+  if (wide_nodes.empty()) {
+    return closest_object;
+  }
+
+  BVH_ray setup;
+  setup_ray(ray, setup);
+
+  BVH_entry fixed_stack[BVH_STACK_SIZE];
+  vector<BVH_entry> spilled_stack;
+  BVH_entry *stack = traversal_stack(stack_needed, fixed_stack, spilled_stack);
+  int stack_size = 0;
+  BVH_entry current = {0, 0, 0};
+
+  while (true) {
+    if (current.count > 0 && LEAF_SIMD) {
+      for (int b = pool.first_block(current.index); b < pool.end_block(current.index + current.count); b++) {
+        int closest = pool.closest_in_block(b, ray, closest_t, hit);
+        if (closest != -1) {
+          closest_object = pool.object(closest);
+        }
+      }
+    }
+    else if (current.count > 0) {
+      for (int i = current.index; i < current.index + current.count; i++) {
+        if (pool.intersect(i, ray, closest_t, hit)) {
+          closest_t = hit.distance;
+          closest_object = pool.object(i);
+        }
+      }
+    }
+    else {
+      BVH4_node &node = wide_nodes[current.index];
+      float t[BVH_WIDTH];
+      int mask = child_entries(node, setup, closest_t, t);
+
+      // The children that were hit are sorted by entry distance with an insertion sort, since there are at most four.
+      BVH_entry hits[BVH_WIDTH];
+      int hit_count = 0;
+      for (int i = 0; i < node.child_count; i++) {
+        if (!(mask & (1 << i))) {
+          continue;
+        }
+        int j = hit_count++;
+        while (j > 0 && hits[j - 1].t > t[i]) {
+          hits[j] = hits[j - 1];
+          j--;
+        }
+        hits[j].index = node.child[i];
+        hits[j].count = node.count[i];
+        hits[j].t = t[i];
+      }
+
+      if (hit_count > 0) {
+        for (int i = hit_count - 1; i > 0; i--) {
+          stack[stack_size++] = hits[i];
+        }
+        current = hits[0];
+        continue;
+      }
+    }
+
+    // Deferred children that now lie beyond the closest hit are skipped.
+    do {
+      if (stack_size == 0) {
+        return closest_object;
+      }
+      stack_size--;
+    } while (stack[stack_size].t >= closest_t);
+    current = stack[stack_size];
+  }
+}
+
+// Objects are tested in any order, and the query stops as soon as an opaque object blocks the ray.
+float BVH::occlusion (const Ray &ray, float tmax, Object **blocker) {
+  float pass = 1;
+  if (wide_nodes.empty()) {
+    return pass;
+  }
+
+  BVH_ray setup;
+  setup_ray(ray, setup);
+
+  BVH_entry fixed_stack[BVH_STACK_SIZE];
+  vector<BVH_entry> spilled_stack;
+  BVH_entry *stack = traversal_stack(stack_needed, fixed_stack, spilled_stack);
+  int stack_size = 0;
+  BVH_entry root = {0, 0, 0};
+  stack[stack_size++] = root;
+
+  while (stack_size > 0) {
+    BVH_entry current = stack[--stack_size];
+    if (current.count > 0 && LEAF_SIMD) {
+      for (int b = pool.first_block(current.index); b < pool.end_block(current.index + current.count); b++) {
+        if (pool.occlude_in_block(b, ray, tmax, pass, blocker)) {
+          return 0;
+        }
+      }
+      continue;
+    }
+    if (current.count > 0) {
+      for (int i = current.index; i < current.index + current.count; i++) {
+        pass = pass*pool.transmission(i, ray, tmax);
+        if (pass <= 0) {
+          if (blocker != NULL) {
+            *blocker = pool.object(i);
+          }
+          return 0;
+        }
+      }
+      continue;
+    }
+
+    BVH4_node &node = wide_nodes[current.index];
+    float t[BVH_WIDTH];
+    int mask = child_entries(node, setup, tmax, t);
+    for (int i = 0; i < node.child_count; i++) {
+      if (mask & (1 << i)) {
+        BVH_entry child = {node.child[i], node.count[i], t[i]};
+        stack[stack_size++] = child;
+      }
+    }
+  }
+  return pass;
+}
+
+// This function counts the objects that a ray hits before tmax, and stops once it has counted limit of them. Instances
+// use it to dim shadow rays once for each face of their mesh, since the faces take the instance's material.
+int BVH::crossings (const Ray &ray, float tmax, int limit) {
+  int count = 0;
+  if (wide_nodes.empty()) {
+    return count;
+  }
+
+  BVH_ray setup;
+  setup_ray(ray, setup);
+
+  BVH_entry fixed_stack[BVH_STACK_SIZE];
+  vector<BVH_entry> spilled_stack;
+  BVH_entry *stack = traversal_stack(stack_needed, fixed_stack, spilled_stack);
+  int stack_size = 0;
+  BVH_entry root = {0, 0, 0};
+  stack[stack_size++] = root;
+
+  while (stack_size > 0) {
+    BVH_entry current = stack[--stack_size];
+    if (current.count > 0) {
+      for (int i = current.index; i < current.index + current.count; i++) {
+        Intersection contact;
+        if (pool.intersect(i, ray, tmax, contact) && ++count >= limit) {
+          return count;
+        }
+      }
+      continue;
+    }
+
+    BVH4_node &node = wide_nodes[current.index];
+    float t[BVH_WIDTH];
+    int mask = child_entries(node, setup, tmax, t);
+    for (int i = 0; i < node.child_count; i++) {
+      if (mask & (1 << i)) {
+        BVH_entry child = {node.child[i], node.count[i], t[i]};
+        stack[stack_size++] = child;
+      }
+    }
+  }
+  return count;
+}
+
+// This holds the parts of a packet that every box test needs. Each ray keeps its own direction, so the rays of a packet
+// may enter a slab through different faces.
+struct BVH_packet {
+  alignas(16) float origin[3][PACKET_SIZE];
+  alignas(16) float inverse[3][PACKET_SIZE];
+};
+
+static void setup_packet (const Ray_packet &packet, BVH_packet &setup) {
+  for (int axis = 0; axis < 3; axis++) {
+    for (int lane = 0; lane < PACKET_SIZE; lane++) {
+      setup.origin[axis][lane] = packet.origin[axis][lane];
+      setup.inverse[axis][lane] = 1/packet.direction[axis][lane];
+    }
+  }
+}
+
+// This function tests the rays of a packet whose bits are set in mask against every child of a wide node. It fills in a
+// mask of the rays that hit each child before their own tmax, along with their entry distances. Each ray's distances
+// are found exactly as child_entries finds them, so a packet visits every box that its rays would visit alone.
+static void packet_child_entries (BVH4_node &node, BVH_packet &packet, const float (&tmax)[PACKET_SIZE], int mask,
+                                  int (&masks)[BVH_WIDTH], float (&t)[BVH_WIDTH][PACKET_SIZE]) {
+  float scale[3];
+  for (int axis = 0; axis < 3; axis++) {
+    scale[axis] = exponent_scale(node.exponent[axis]);
+  }
+#ifdef __SSE2__
+  __m128 zero = _mm_setzero_ps();
+  __m128 offset[3];
+  __m128 inverse[3];
+  __m128 negative[3];
+  for (int axis = 0; axis < 3; axis++) {
+    offset[axis] = _mm_sub_ps(_mm_set1_ps(node.origin[axis]), _mm_load_ps(packet.origin[axis]));
+    inverse[axis] = _mm_load_ps(packet.inverse[axis]);
+    negative[axis] = _mm_cmplt_ps(inverse[axis], zero);
+  }
+  for (int i = 0; i < node.child_count; i++) {
+    __m128 t_near = zero;
+    __m128 t_far = _mm_load_ps(tmax);
+    for (int axis = 0; axis < 3; axis++) {
+      __m128 lower = _mm_set1_ps(node.lower[axis][i]*scale[axis]);
+      __m128 upper = _mm_set1_ps(node.upper[axis][i]*scale[axis]);
+      __m128 near_side = _mm_or_ps(_mm_and_ps(negative[axis], upper), _mm_andnot_ps(negative[axis], lower));
+      __m128 far_side = _mm_or_ps(_mm_and_ps(negative[axis], lower), _mm_andnot_ps(negative[axis], upper));
+      __m128 near_t = _mm_mul_ps(_mm_add_ps(near_side, offset[axis]), inverse[axis]);
+      __m128 far_t = _mm_mul_ps(_mm_add_ps(far_side, offset[axis]), inverse[axis]);
+      t_near = _mm_max_ps(near_t, t_near);
+      t_far = _mm_min_ps(far_t, t_far);
+    }
+    t_far = _mm_mul_ps(t_far, _mm_set1_ps(BVH_FAR_PADDING));
+    _mm_storeu_ps(t[i], t_near);
+    masks[i] = _mm_movemask_ps(_mm_cmple_ps(t_near, t_far)) & mask;
+  }
+#else
+  for (int i = 0; i < node.child_count; i++) {
+    masks[i] = 0;
+    for (int lane = 0; lane < PACKET_SIZE; lane++) {
+      float t_near = 0;
+      float t_far = tmax[lane];
+      for (int axis = 0; axis < 3; axis++) {
+        bool negative = packet.inverse[axis][lane] < 0;
+        float offset = node.origin[axis] - packet.origin[axis][lane];
+        unsigned char near_step = negative ? node.upper[axis][i] : node.lower[axis][i];
+        unsigned char far_step = negative ? node.lower[axis][i] : node.upper[axis][i];
+        float near_t = (near_step*scale[axis] + offset)*packet.inverse[axis][lane];
+        float far_t = (far_step*scale[axis] + offset)*packet.inverse[axis][lane];
+        t_near = near_t > t_near ? near_t : t_near;
+        t_far = far_t < t_far ? far_t : t_far;
+      }
+      t[i][lane] = t_near;
+      if (t_near <= t_far*BVH_FAR_PADDING) {
+        masks[i] |= 1 << lane;
+      }
+    }
+    masks[i] &= mask;
+  }
+#endif
+}
+
+// This is an entry on a packet's traversal stack, which remembers which of the rays entered the child and where.
+struct BVH_packet_entry {
+  int index;
+  int count;
+  int mask;
+  float t[PACKET_SIZE];
+};
+
+// This function returns the rays of an entry that enter it before their closest hits.
+static int rays_ahead (BVH_packet_entry &entry, float (&closest_t)[PACKET_SIZE]) {
+  int mask = entry.mask;
+  for (int lane = 0; lane < PACKET_SIZE; lane++) {
+    if ((mask & (1 << lane)) && entry.t[lane] >= closest_t[lane]) {
+      mask &= ~(1 << lane);
+    }
+  }
+  return mask;
+}
+
+// A packet visits a child if any of its rays enter it, but only those rays are tested against the child's objects.
+// The children are visited in order of the nearest entry among their rays, and deferred children are skipped once
+// every ray that entered them has found a closer hit.
+int BVH::closest_intersection_packet (const Ray_packet &packet, int mask, float (&closest_t)[PACKET_SIZE],
+                                      Intersection (&hits)[PACKET_SIZE], Object *(&objects)[PACKET_SIZE]) {
+  int hit_mask = 0;
+  for (int lane = 0; lane < PACKET_SIZE; lane++) {
+    objects[lane] = NULL;
+  }
+  if (wide_nodes.empty() || mask == 0) {
+    return hit_mask;
+  }
+
+  BVH_packet setup;
+  setup_packet(packet, setup);
+
+  BVH_packet_entry fixed_stack[BVH_STACK_SIZE];
+  vector<BVH_packet_entry> spilled_stack;
+  BVH_packet_entry *stack = traversal_stack(stack_needed, fixed_stack, spilled_stack);
+  int stack_size = 0;
+  BVH_packet_entry current = {0, 0, mask, {0}};
+
+  while (true) {
+    if (current.count > 0) {
+      for (int i = current.index; i < current.index + current.count; i++) {
+        int closer = pool.intersect_packet(i, packet, current.mask, closest_t, hits);
+        for (int lane = 0; lane < PACKET_SIZE; lane++) {
+          if (closer & (1 << lane)) {
+            closest_t[lane] = hits[lane].distance;
+            objects[lane] = pool.object(i);
+          }
+        }
+        hit_mask |= closer;
+      }
+    }
+    else {
+      BVH4_node &node = wide_nodes[current.index];
+      int masks[BVH_WIDTH];
+      float t[BVH_WIDTH][PACKET_SIZE];
+      packet_child_entries(node, setup, closest_t, current.mask, masks, t);
+
+      int order[BVH_WIDTH];
+      float nearest[BVH_WIDTH];
+      int hit_count = 0;
+      for (int i = 0; i < node.child_count; i++) {
+        if (masks[i] == 0) {
+          continue;
+        }
+        float entry = FLT_MAX;
+        for (int lane = 0; lane < PACKET_SIZE; lane++) {
+          if (masks[i] & (1 << lane)) {
+            entry = min(entry, t[i][lane]);
+          }
+        }
+        int j = hit_count++;
+        while (j > 0 && nearest[j - 1] > entry) {
+          order[j] = order[j - 1];
+          nearest[j] = nearest[j - 1];
+          j--;
+        }
+        order[j] = i;
+        nearest[j] = entry;
+      }
+
+      if (hit_count > 0) {
+        for (int i = hit_count - 1; i >= 0; i--) {
+          BVH_packet_entry &child = i > 0 ? stack[stack_size++] : current;
+          child.index = node.child[order[i]];
+          child.count = node.count[order[i]];
+          child.mask = masks[order[i]];
+          memcpy(child.t, t[order[i]], sizeof(child.t));
+        }
+        continue;
+      }
+    }
+
+    // Deferred children are only visited by the rays that haven't found a closer hit since they were pushed.
+    do {
+      if (stack_size == 0) {
+        return hit_mask;
+      }
+      stack_size--;
+      stack[stack_size].mask = rays_ahead(stack[stack_size], closest_t);
+    } while (stack[stack_size].mask == 0);
+    current = stack[stack_size];
+  }
+}
+
+// Each ray stops being traced once an opaque object blocks it, and the query ends once every ray is blocked.
+void BVH::occlusion_packet (const Ray_packet &packet, int mask, const float (&tmax)[PACKET_SIZE],
+                            float (&pass)[PACKET_SIZE], Object *(&blockers)[PACKET_SIZE]) {
+  for (int lane = 0; lane < PACKET_SIZE; lane++) {
+    pass[lane] = 1;
+    blockers[lane] = NULL;
+  }
+  if (wide_nodes.empty() || mask == 0) {
+    return;
+  }
+
+  BVH_packet setup;
+  setup_packet(packet, setup);
+
+  BVH_packet_entry fixed_stack[BVH_STACK_SIZE];
+  vector<BVH_packet_entry> spilled_stack;
+  BVH_packet_entry *stack = traversal_stack(stack_needed, fixed_stack, spilled_stack);
+  int stack_size = 0;
+  BVH_packet_entry root = {0, 0, mask, {0}};
+  stack[stack_size++] = root;
+  int unblocked = mask;
+
+  while (stack_size > 0) {
+    BVH_packet_entry current = stack[--stack_size];
+    int active = current.mask & unblocked;
+    if (active == 0) {
+      continue;
+    }
+    if (current.count > 0) {
+      for (int i = current.index; i < current.index + current.count && active != 0; i++) {
+        float passed[PACKET_SIZE];
+        int dimmed = pool.transmission_packet(i, packet, active, tmax, passed);
+        for (int lane = 0; lane < PACKET_SIZE; lane++) {
+          if (!(dimmed & (1 << lane))) {
+            continue;
+          }
+          pass[lane] = pass[lane]*passed[lane];
+          if (pass[lane] <= 0) {
+            pass[lane] = 0;
+            blockers[lane] = pool.object(i);
+            active &= ~(1 << lane);
+            unblocked &= ~(1 << lane);
+          }
+        }
+      }
+      if (unblocked == 0) {
+        return;
+      }
+      continue;
+    }
+
+    BVH4_node &node = wide_nodes[current.index];
+    int masks[BVH_WIDTH];
+    float t[BVH_WIDTH][PACKET_SIZE];
+    packet_child_entries(node, setup, tmax, active, masks, t);
+    for (int i = 0; i < node.child_count; i++) {
+      if (masks[i] != 0) {
+        BVH_packet_entry child = {node.child[i], node.count[i], masks[i], {0}};
+        stack[stack_size++] = child;
+      }
+    }
+  }
+}
@@ -1,282 +1,385 @@
-#include <cstdlib>
-#include <vector>
-#include <cmath>
-#include <cfloat>
-
-#include "Properties.h"
-#include "Vectors.h"
-#include "Objects.h"
-#include "Lights.h"
-
-using namespace std;
-
-const float pi = 4.0 * atan(1.0);
-
-// This function returns the closest object with a positive intersection distance.
-Object *closest_intersection(vector<Object*> &objects, Vector *target_ray) {
-  Intersection *intersection = NULL;
-  Object *closest_object = NULL;
-  float closest_t = FLT_MAX;
-
-  for (vector<Object*>::iterator i = objects.begin(); i != objects.end(); ++i) {
-    intersection = (*i)->ray_intersect(target_ray);
-    if (intersection->distance > 0 && intersection->distance < closest_t) {
-      closest_t = intersection->distance;
-      closest_object = *i;
-    }
-    delete intersection;
-  }
-  return closest_object;
-}
-
-
-float *color_pixel (Object *target, Vector *target_ray,
-                    vector<Object*> &objects,
-                    vector<Light*> &lights,
-                    Properties *properties,
-                    int **pixels, int pixel_index,
-                    vector<float> &refraction_indices, int depth) {
-
-  if (target != NULL && depth < MAX_DEPTH) { //If there is an intersecting object, then the pixel is assigned a color based on the extended Phong Illumination Model.
-     Intersection *intersection = target->ray_intersect(target_ray);
-
-     float color[3];
-     // If the object has a texture, it will override the base color.
-     Texture *texture = target->get_texture();
-     if (texture != NULL) {
-       target->texture_color(intersection, color);
-     }
-     else {
-       color[0] = target->get_material()->color[0];
-       color[1] = target->get_material()->color[1];
-       color[2] = target->get_material()->color[2];
-     }
-
-     Vector *normal = target->find_normal(intersection);
-
-     Vector *incident = copy_vector(target_ray);
-     scale_vector(incident, -1);
-
-     float transmit_index;
-     float incident_index;
-
-     bool exiting = dot_product(normal, target_ray) > 0;
-
-     // The exiting check is used to see if the normal should be inverted.
-     // The orientation of the refraction indicies is decided here as well.
-     if (exiting) {
-       scale_vector(normal, -1);
-       transmit_index = refraction_indices.back();
-       incident_index = target->get_material()->refraction_index;
-     }
-     else {
-       transmit_index = target->get_material()->refraction_index;
-       incident_index = refraction_indices.back();
-     }
-
-     // The normal's origin is adjusted to avoid unwanted self-collision.
-     float x_bias = (normal->xd*SHADOW_BIAS);
-     float y_bias = (normal->yd*SHADOW_BIAS);
-     float z_bias = (normal->zd*SHADOW_BIAS);
-     normal->x += x_bias;
-     normal->y += y_bias;
-     normal->z += z_bias;
-
-     // The reflection ray is computer here.
-     Vector *reflection_ray = copy_vector(normal);
-     scale_vector(reflection_ray, 2*dot_product(normal, incident));
-     Vector *subtraction = subtract_vectors(reflection_ray, incident);
-     delete reflection_ray;
-     reflection_ray = subtraction;
-     unit_vector(reflection_ray);
-
-     float incident_angle = acos(dot_product(incident, normal));
-
-     // The Fresnel values are found next.
-     float r_index = target->get_material()->refraction_index;
-     float opacity = target->get_material()->opacity;
-     float f_0 = pow((r_index - 1)/(r_index + 1), 2);
-     float fresnel = f_0 + (1 - f_0)*pow(1 - cos(incident_angle), 5);
-
-     // For reflection rays during a medium exit, the current internal refraction index is pushed back.
-     if (exiting) {
-       refraction_indices.push_back(target->get_material()->refraction_index);
-     }
-
-     // The color returned by the reflected ray is recursively found.
-     Object *reflection_contact = closest_intersection(objects, reflection_ray);
-     float *reflection_result = color_pixel(reflection_contact, reflection_ray, objects, lights, properties, pixels, pixel_index, refraction_indices, depth + 1);
-
-     // The state of the stack is reverted for previous calls.
-     if (exiting) {
-       refraction_indices.pop_back();
-     }
-
-     // The normal origin is adjusted again for the transmitted ray.
-     normal->x -= 2*x_bias;
-     normal->y -= 2*y_bias;
-     normal->z -= 2*z_bias;
-
-     float *transmit_result;
-
-     // This if check is used to detect total internal reflecion.
-     if (sin(incident_angle) <= transmit_index/incident_index) {
-       Vector *addition1 = copy_vector(normal);
-       scale_vector(addition1, -1*sqrt(1 - (pow(incident_index/transmit_index, 2)*(1 - pow(cos(incident_angle), 2)))));
-       Vector *subtraction = copy_vector(normal);
-       scale_vector(subtraction, cos(incident_angle));
-       Vector *addition2 = subtract_vectors(subtraction, incident);
-       scale_vector(addition2, incident_index/transmit_index);
-       Vector *transmitted_ray = add_vectors(addition1, addition2);
-       unit_vector(transmitted_ray);
-       delete subtraction;
-       delete addition1;
-       delete addition2;
-
-       Object *transmit_contact = closest_intersection(objects, transmitted_ray);
-
-
-       // The refraction index stack is adjusted depending on whether the ray is entering or exiting the current object.
-       if (exiting) {
-         refraction_indices.pop_back();
-       }
-       else {
-         refraction_indices.push_back(target->get_material()->refraction_index);
-       }
-
-       // The color returned by the transmitted ray is found with recursion.
-       transmit_result = color_pixel(transmit_contact, transmitted_ray, objects, lights, properties, pixels, pixel_index, refraction_indices, depth + 1);
-
-       // The stack is reverted for previous calls.
-       if (exiting) {
-         refraction_indices.push_back(target->get_material()->refraction_index);
-       }
-       else {
-         refraction_indices.pop_back();
-       }
-
-       delete transmitted_ray;
-     }
-     else {
-       // If total internal reflection occurs, then the transmitted result will have no effect.
-       transmit_result = new float[3];
-       transmit_result[0] = 0;
-       transmit_result[1] = 0;
-       transmit_result[2] = 0;
-     }
-
-     float ambient_r = target->get_material()->k_ads[0]*color[0];
-     float l_r = ambient_r + sum_lights(target, objects, lights, properties, intersection, color, 0) + (fresnel*reflection_result[0]) + (1 - fresnel)*(1 - opacity)*transmit_result[0];
-     if (l_r > 1) {
-       l_r = 1;
-     }
-
-     float ambient_g = target->get_material()->k_ads[0]*color[1];
-     float l_g = ambient_g + sum_lights(target, objects, lights, properties, intersection, color, 1) + (fresnel*reflection_result[1]) + (1 - fresnel)*(1 - opacity)*transmit_result[1];
-     if (l_g > 1) {
-       l_g = 1;
-     }
-
-     float ambient_b = target->get_material()->k_ads[0]*color[2];
-     float l_b = ambient_b + sum_lights(target, objects, lights, properties, intersection, color, 2) + (fresnel*reflection_result[2]) + (1 - fresnel)*(1 - opacity)*transmit_result[2];
-     if (l_b > 1) {
-       l_b = 1;
-     }
-
-     delete intersection;
-     delete normal;
-     delete incident;
-     delete reflection_ray;
-     delete[] reflection_result;
-     delete[] transmit_result;
-
-     // If the recursion depth is zero, then the color is copied into the pixel array.
-     if (depth == 0) {
-       pixels[pixel_index][0] = (int)(255*l_r);
-       pixels[pixel_index][1] = (int)(255*l_g);
-       pixels[pixel_index][2] = (int)(255*l_b);
-       return NULL;
-     }
-     // Otherwise, the color is returned to previous calls.
-     else {
-       float *result_color = new float[3];
-       result_color[0] = l_r;
-       result_color[1] = l_g;
-       result_color[2] = l_b;
-       return result_color;
-     }
-  }
-  // If an intersection occurs past the max depth, then the non-recursed color is added.
-  else if (target != NULL && depth == MAX_DEPTH) {
-    Intersection *intersection = target->ray_intersect(target_ray);
-
-    float color[3];
-    // If the object has a texture, it will override the base color.
-    Texture *texture = target->get_texture();
-    if (texture != NULL) {
-      target->texture_color(intersection, color);
-    }
-    else {
-      color[0] = target->get_material()->color[0];
-      color[1] = target->get_material()->color[1];
-      color[2] = target->get_material()->color[2];
-    }
-
-    float ambient_r = target->get_material()->k_ads[0]*color[0];
-    float l_r = ambient_r + sum_lights(target, objects, lights, properties, intersection, color, 0);
-    if (l_r > 1) {
-      l_r = 1;
-    }
-
-    float ambient_g = target->get_material()->k_ads[0]*color[1];
-    float l_g = ambient_g + sum_lights(target, objects, lights, properties, intersection, color, 1);
-    if (l_g > 1) {
-      l_g = 1;
-    }
-
-    float ambient_b = target->get_material()->k_ads[0]*color[2];
-    float l_b = ambient_b + sum_lights(target, objects, lights, properties, intersection, color, 2);
-    if (l_b > 1) {
-      l_b = 1;
-    }
-
-    delete intersection;
-
-    float *result_color = new float[3];
-    result_color[0] = l_r;
-    result_color[1] = l_g;
-    result_color[2] = l_b;
-    return result_color;
-  }
-  //If there is no intersection, then the pixel is assigned the color of the background.
-  else if (target == NULL && depth == 0) {
-    pixels[pixel_index][0] = (int)(255*properties->bkgcolor[0]);
-    pixels[pixel_index][1] = (int)(255*properties->bkgcolor[1]);
-    pixels[pixel_index][2] = (int)(255*properties->bkgcolor[2]);
-    return NULL;
-  }
-  else {
-    float *result_color = new float[3];
-    result_color[0] = properties->bkgcolor[0];
-    result_color[1] = properties->bkgcolor[1];
-    result_color[2] = properties->bkgcolor[2];
-    return result_color;
-  }
-}
-
-// This function sums illumination from multiple lights for the Phong-Illumination model.
-float sum_lights (Object *target, vector<Object*> &objects, vector<Light*> &lights, Properties *properties, Intersection *intersection, float (&color)[3], int rgb_index) {
-  float sum = 0;
-  Vector *normal = target->find_normal(intersection);
-  Vector *v = new_vector(intersection->x, intersection->y, intersection->z, properties->eye[0], properties->eye[1], properties->eye[2]);
-  unit_vector(v);
-  float ko_d = target->get_material()->k_ads[1]*color[rgb_index];
-  float ko_s = target->get_material()->k_ads[2]*target->get_material()->specular[rgb_index];
-
-  for (vector<Light*>::iterator i = lights.begin(); i != lights.end(); ++i) {
-    sum += (*i)->shadow(intersection, objects, normal)*(*i)->illumination(normal, v, intersection, ko_d, ko_s, target->get_material()->n, rgb_index);
-  }
-  delete normal;
-  delete v;
-  return sum;
-}
+#include <cstdlib>
+#include <vector>
+#include <cmath>
+#include <cfloat>
+
+#include "Properties.h"
+#include "Vectors.h"
+#include "Objects.h"
+#include "Lights.h"
+#include "Accelerators.h"
+#include "Wavefront.h"
+
+using namespace std;
+
+const float pi = 4.0 * atan(1.0);
+
+// This function builds the chosen accelerator over the scene's objects.
+Accelerator *build_accelerator(vector<Object*> &objects, int type) {
+  if (type == ACCEL_GRID) {
+    return new Grid(objects);
+  }
+  return new BVH(objects);
+}
+
+// This function returns the closest object with a positive intersection distance, and fills in the hit for shading.
+// The accelerator is traversed so that only objects near the ray are tested.
+Object *closest_intersection(Accelerator *accelerator, const Ray &target_ray, Intersection &hit, Render_state *state) {
+  state->closest_queries++;
+  float closest_t = FLT_MAX;
+  Object *contact = accelerator->closest_intersection(target_ray, closest_t, hit);
+  if (contact != NULL) {
+    contact->complete_hit(target_ray, hit);
+  }
+  return contact;
+}
+
+// This function finds the closest hits of the rays of a packet whose bits are set in mask, and fills in each hit for
+// shading. It returns a mask of the rays that hit anything.
+int closest_intersections(Accelerator *accelerator, const Ray_packet &packet, int mask, Intersection (&hits)[PACKET_SIZE],
+                          Object *(&contacts)[PACKET_SIZE], Render_state *state) {
+  float closest_t[PACKET_SIZE];
+  for (int lane = 0; lane < PACKET_SIZE; lane++) {
+    closest_t[lane] = FLT_MAX;
+  }
+  int hit_mask = accelerator->closest_intersection_packet(packet, mask, closest_t, hits, contacts);
+  for (int lane = 0; lane < PACKET_SIZE; lane++) {
+    if (mask & (1 << lane)) {
+      state->closest_queries++;
+    }
+    if (hit_mask & (1 << lane)) {
+      contacts[lane]->complete_hit(packet.rays[lane], hits[lane]);
+    }
+  }
+  return hit_mask;
+}
+
+// This function gives a rendering thread an empty shadow cache for every light.
+void init_render_state(Render_state *state, vector<Light*> &lights) {
+  Shadow_cache empty = {NULL, 0, 0};
+  state->shadow_caches.assign(lights.size(), empty);
+  state->selected_lights.reserve(lights.size());
+  state->light_choices.reserve(lights.size());
+  state->closest_queries = 0;
+  state->light_gathers = 0;
+  state->lights_gathered = 0;
+  state->key.pixel = 0;
+  state->key.frame = 0;
+  state->key.path = 1;
+  state->wavefront = new Wavefront;
+}
+
+// This function frees the memory that a rendering thread's state holds outside of itself.
+void free_render_state(Render_state *state) {
+  delete state->wavefront;
+  state->wavefront = NULL;
+}
+
+// Most objects dim a shadow ray once, however many times it crosses their surface.
+float Object::transmission (const Ray &ray, float tmax, float opacity) {
+  Intersection contact;
+  return ray_intersect(ray, tmax, contact) ? 1 - opacity : 1;
+}
+
+// The object that last blocked a light is tested before the accelerator is searched. Only opaque objects are cached,
+// so hitting one means that no light can pass. After a miss, the cache holds whatever blocked the ray, if anything.
+float cached_occlusion(Accelerator *accelerator, const Ray &shadow_ray, float tmax, Shadow_cache &cache) {
+  cache.lookups++;
+  if (cache.occluder != NULL) {
+    Intersection contact;
+    if (cache.occluder->ray_intersect(shadow_ray, tmax, contact)) {
+      cache.hits++;
+      return 0;
+    }
+  }
+  cache.occluder = NULL;
+  return accelerator->occlusion(shadow_ray, tmax, &cache.occluder);
+}
+
+// This function traces shadow rays that share one light's cache, and stores the light that each lets through in passes.
+// Rays that start near each other and head the same way are traced together in packets. Each ray still tests the
+// cached occluder first, and the cache then holds whatever blocked the last ray that was traced.
+void cached_occlusions(Accelerator *accelerator, const Ray *shadow_rays, const float *tmax, int count, Shadow_cache &cache, float *passes) {
+  for (int first = 0; first < count; first += PACKET_SIZE) {
+    Ray_packet packet;
+    float packet_tmax[PACKET_SIZE];
+    int mask = 0;
+    for (int lane = 0; lane < PACKET_SIZE; lane++) {
+      // Unused lanes repeat the first ray so that every lane holds real numbers.
+      int ray = first + lane < count ? first + lane : first;
+      set_packet_ray(packet, lane, shadow_rays[ray]);
+      packet_tmax[lane] = tmax[ray];
+      if (first + lane >= count) {
+        continue;
+      }
+
+      cache.lookups++;
+      Intersection contact;
+      if (cache.occluder != NULL && cache.occluder->ray_intersect(shadow_rays[ray], tmax[ray], contact)) {
+        cache.hits++;
+        passes[ray] = 0;
+        continue;
+      }
+      mask |= 1 << lane;
+    }
+    if (mask == 0) {
+      continue;
+    }
+
+    float pass[PACKET_SIZE];
+    Object *blockers[PACKET_SIZE];
+    accelerator->occlusion_packet(packet, mask, packet_tmax, pass, blockers);
+    for (int lane = 0; lane < PACKET_SIZE; lane++) {
+      if (mask & (1 << lane)) {
+        passes[first + lane] = pass[lane];
+        cache.occluder = blockers[lane];
+      }
+    }
+  }
+}
+
+// This function traces several shadow rays toward one light and returns the sum of the light that each lets through.
+// The rays all start at the same point and end near the same place, so they are traced together in packets.
+float cached_occlusion_sum(Accelerator *accelerator, Ray *shadow_rays, float *tmax, int count, Shadow_cache &cache) {
+  if (count == 1) {
+    return cached_occlusion(accelerator, shadow_rays[0], tmax[0], cache);
+  }
+
+  float passes[MAX_SHADOW_RAYS];
+  cached_occlusions(accelerator, shadow_rays, tmax, count, cache, passes);
+  float sum = 0;
+  for (int ray = 0; ray < count; ray++) {
+    sum += passes[ray];
+  }
+  return sum;
+}
+
+// This function finds the color of an object's surface at a hit. If the object has a texture, it overrides the base color.
+void surface_color (Object *target, const Intersection &hit, float (&color)[3]) {
+  Texture *texture = target->get_texture();
+  if (texture != NULL) {
+    target->texture_color(hit, color);
+  }
+  else {
+    color[0] = target->get_material()->color[0];
+    color[1] = target->get_material()->color[1];
+    color[2] = target->get_material()->color[2];
+  }
+}
+
+// This function finds the reflected and transmitted rays that leave a hit, along with the Fresnel and opacity weights
+// of their colors. The scattering's refraction stacks must start as copies of the incoming ray's.
+void scatter_rays (Object *target, const Ray &target_ray, const Intersection &hit, Scattering &scattering) {
+  Vec3 normal = hit.normal;
+  Vec3 geometric_normal = hit.geometric_normal;
+
+  Vec3 incident = -target_ray.direction;
+
+  float transmit_index;
+  float incident_index;
+
+  bool exiting = dot_product(normal, target_ray.direction) > 0;
+
+  // The exiting check is used to see if the normal should be inverted.
+  // The orientation of the refraction indicies is decided here as well.
+  if (exiting) {
+    normal = -normal;
+    geometric_normal = -geometric_normal;
+    transmit_index = scattering.reflection_indices.back();
+    incident_index = target->get_material()->refraction_index;
+  }
+  else {
+    transmit_index = target->get_material()->refraction_index;
+    incident_index = scattering.reflection_indices.back();
+  }
+
+  // The reflected and transmitted rays start just off of either side of the surface to avoid unwanted self-collision.
+  Vec3 bias = geometric_normal*SHADOW_BIAS;
+
+  // The reflection ray is computer here.
+  scattering.reflection_ray = Ray{hit.point + bias, unit_vector(normal*(2*dot_product(normal, incident)) - incident)};
+
+  float incident_angle = acos(dot_product(incident, normal));
+
+  // The Fresnel values are found next.
+  float r_index = target->get_material()->refraction_index;
+  float opacity = target->get_material()->opacity;
+  float f_0 = pow((r_index - 1)/(r_index + 1), 2);
+  float fresnel = f_0 + (1 - f_0)*pow(1 - cos(incident_angle), 5);
+  scattering.reflection_weight = fresnel;
+  scattering.transmission_weight = (1 - fresnel)*(1 - opacity);
+
+  // For reflection rays during a medium exit, the current internal refraction index is pushed back.
+  if (exiting) {
+    scattering.reflection_indices.push(r_index);
+  }
+
+  // This check is used to detect total internal reflecion, which leaves no transmitted ray.
+  scattering.transmits = sin(incident_angle) <= transmit_index/incident_index;
+  if (scattering.transmits) {
+    Vec3 addition1 = normal*(-1*sqrt(1 - (pow(incident_index/transmit_index, 2)*(1 - pow(cos(incident_angle), 2)))));
+    Vec3 addition2 = (normal*cos(incident_angle) - incident)*(incident_index/transmit_index);
+    scattering.transmitted_ray = Ray{hit.point - bias, unit_vector(addition1 + addition2)};
+
+    // The refraction index stack is adjusted depending on whether the ray is entering or exiting the current object.
+    if (exiting) {
+      scattering.transmission_indices.pop();
+    }
+    else {
+      scattering.transmission_indices.push(r_index);
+    }
+  }
+}
+
+// This function adds a point's ambient light to the light that reaches it from the scene's lights.
+void own_light (Object *target, float (&color)[3], float (&light_sum)[3], float (&own)[3]) {
+  for (int rgb_index = 0; rgb_index < 3; rgb_index++) {
+    float ambient = target->get_material()->k_ads[0]*color[rgb_index];
+    own[rgb_index] = ambient + light_sum[rgb_index];
+  }
+}
+
+// This function adds the weighted colors of a point's reflected and transmitted rays to its own light.
+// Every point's color is clamped before it is weighted by the point that its ray left from.
+Color blend_colors (float (&own)[3], float reflection_weight, const Color &reflected, float transmission_weight, const Color &transmitted) {
+  float l_r = own[0] + (reflection_weight*reflected.r) + transmission_weight*transmitted.r;
+  float l_g = own[1] + (reflection_weight*reflected.g) + transmission_weight*transmitted.g;
+  float l_b = own[2] + (reflection_weight*reflected.b) + transmission_weight*transmitted.b;
+  Color result_color = {l_r > 1 ? 1 : l_r, l_g > 1 ? 1 : l_g, l_b > 1 ? 1 : l_b};
+  return result_color;
+}
+
+// This function returns a point's own light as a color, for points whose rays aren't traced.
+Color clamp_color (float (&own)[3]) {
+  Color result_color = {own[0] > 1 ? 1 : own[0], own[1] > 1 ? 1 : own[1], own[2] > 1 ? 1 : own[2]};
+  return result_color;
+}
+
+
+Color color_pixel (Object *target, const Ray &target_ray, const Intersection &hit,
+                   Accelerator *accelerator, Light_tree *light_tree,
+                   Properties *properties,
+                   Refraction_stack &refraction_indices, Render_state *state, int depth) {
+
+  //If there is no intersection, then the pixel is assigned the color of the background.
+  if (target == NULL) {
+    Color result_color = {properties->bkgcolor[0], properties->bkgcolor[1], properties->bkgcolor[2]};
+    return result_color;
+  }
+
+  //If there is an intersecting object, then the pixel is assigned a color based on the extended Phong Illumination Model.
+  float color[3];
+  surface_color(target, hit, color);
+
+  // If an intersection occurs past the max depth, then the non-recursed color is added.
+  if (depth == MAX_DEPTH) {
+    float light_sum[3];
+    sum_lights(target, accelerator, light_tree, properties, hit, color, light_sum, state);
+
+    float own[3];
+    own_light(target, color, light_sum, own);
+    return clamp_color(own);
+  }
+
+  Scattering scattering(refraction_indices);
+  scatter_rays(target, target_ray, hit, scattering);
+
+  // Each reflected and transmitted ray extends the key's path, so the points that they shade draw their own numbers.
+  unsigned int path = state->key.path;
+  state->key.path = 2*path;
+
+  // The color returned by the reflected ray is recursively found.
+  Intersection reflection_hit;
+  Object *reflection_contact = closest_intersection(accelerator, scattering.reflection_ray, reflection_hit, state);
+  Color reflection_result = color_pixel(reflection_contact, scattering.reflection_ray, reflection_hit, accelerator, light_tree, properties, scattering.reflection_indices, state, depth + 1);
+
+  // If total internal reflection occurs, then the transmitted result will have no effect.
+  Color transmit_result = {0, 0, 0};
+  if (scattering.transmits) {
+    Intersection transmit_hit;
+    Object *transmit_contact = closest_intersection(accelerator, scattering.transmitted_ray, transmit_hit, state);
+
+    // The color returned by the transmitted ray is found with recursion.
+    state->key.path = 2*path + 1;
+    transmit_result = color_pixel(transmit_contact, scattering.transmitted_ray, transmit_hit, accelerator, light_tree, properties, scattering.transmission_indices, state, depth + 1);
+  }
+
+  state->key.path = path;
+
+  // The shadows for each light are found once and shared by all three color channels.
+  float light_sum[3];
+  sum_lights(target, accelerator, light_tree, properties, hit, color, light_sum, state);
+
+  float own[3];
+  own_light(target, color, light_sum, own);
+  return blend_colors(own, scattering.reflection_weight, reflection_result, scattering.transmission_weight, transmit_result);
+}
+
+// This function adds one light's weighted illumination to the sum, once the fraction of it that reaches the hit is known.
+// The illumination is found for every color channel, while the shadow is only traced once.
+void add_illumination (Object *target, Light *light, const Intersection &hit, Vec3 v, float (&color)[3], float (&sum)[3],
+                       float weight, float shadow_constant) {
+  if (shadow_constant == 0) {
+    return;
+  }
+  for (int rgb_index = 0; rgb_index < 3; rgb_index++) {
+    float ko_d = target->get_material()->k_ads[1]*color[rgb_index];
+    float ko_s = target->get_material()->k_ads[2]*target->get_material()->specular[rgb_index];
+    sum[rgb_index] += weight*shadow_constant*light->illumination(hit, v, ko_d, ko_s, target->get_material()->n, rgb_index);
+  }
+}
+
+// This function lists the lights to shade at a hit, in the order that they are added.
+// Only the lights that the light tree can't rule out are chosen. When "lightsamples" is set, lights without bounds are
+// still chosen, but the rest are replaced by that many lights chosen from the tree, each divided by its chance of being chosen.
+// The sampled sum is noisy, but its average over many samples is the same as shading every light.
+void choose_lights (Light_tree *light_tree, Properties *properties, const Intersection &hit, Render_state *state,
+                    vector<Light_choice> &choices) {
+  float point[3] = {hit.point.x, hit.point.y, hit.point.z};
+  choices.clear();
+  state->light_gathers++;
+
+  if (properties->light_samples > 0) {
+    vector<int> &unbounded = light_tree->get_unbounded();
+    for (vector<int>::iterator l = unbounded.begin(); l != unbounded.end(); ++l) {
+      choices.push_back(Light_choice{*l, 1, 0});
+    }
+    state->lights_gathered += unbounded.size();
+
+    for (int s = 0; s < properties->light_samples; s++) {
+      int light_index;
+      float pdf;
+      // A walk that ends in a group which can't reach the point adds nothing, but still counts as a sample.
+      if (!light_tree->sample(point, random_number(state->key, RANDOM_LIGHT_CHOICE, s), light_index, pdf)) {
+        continue;
+      }
+      choices.push_back(Light_choice{light_index, 1/(pdf*properties->light_samples), s});
+      state->lights_gathered++;
+    }
+  }
+  else {
+    light_tree->gather(point, properties->light_cutoff, state->selected_lights);
+    state->lights_gathered += state->selected_lights.size();
+    for (vector<int>::iterator l = state->selected_lights.begin(); l != state->selected_lights.end(); ++l) {
+      choices.push_back(Light_choice{*l, 1, 0});
+    }
+  }
+}
+
+// This function sums illumination from multiple lights for the Phong-Illumination model.
+void sum_lights (Object *target, Accelerator *accelerator, Light_tree *light_tree, Properties *properties, const Intersection &hit, float (&color)[3], float (&sum)[3], Render_state *state) {
+  Vec3 eye = {properties->eye[0], properties->eye[1], properties->eye[2]};
+  Vec3 v = unit_vector(eye - hit.point);
+
+  for (int rgb_index = 0; rgb_index < 3; rgb_index++) {
+    sum[rgb_index] = 0;
+  }
+
+  vector<Light*> &lights = light_tree->get_lights();
+  choose_lights(light_tree, properties, hit, state, state->light_choices);
+  for (vector<Light_choice>::iterator c = state->light_choices.begin(); c != state->light_choices.end(); ++c) {
+    float shadow_constant = lights[c->light]->shadow(hit, accelerator, state->shadow_caches[c->light], state->key, c->light,
+                                                      c->sample);
+    add_illumination(target, lights[c->light], hit, v, color, sum, c->weight, shadow_constant);
+  }
+}
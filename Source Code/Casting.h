@@ -1,48 +1,191 @@
-#ifndef CASTING_H_
-#define CASTING_H_
-
-#include <cstdlib>
-#include <vector>
-
-#include "Properties.h"
-#include "Vectors.h"
-#include "Objects.h"
-#include "Lights.h"
-
-using namespace std;
-
-// These resolve cyclical includes.
-class Object;
-class Light;
-struct Properties;
-
-// These macros allow for easy adjustment of shadows for the entire program.
-#define SOFT_SHADOWS 0  // This macro toggles soft shadows on and off.
-#define MAX_SHADOW_RAYS 100  // When soft shadows are enabled, this many rays are produced.
-#define OFFSET_MAX 0.015
-#define OFFSET_MIN -0.015
-#define SHADOW_BIAS 0.001
-
-#define MAX_DEPTH 5  // This is a hard cap on the number of reflection/transparency recursions allowed.
-
-struct Intersection {
-  float x;
-  float y;
-  float z;
-  float distance;
-};
-
-Object *closest_intersection(std::vector<Object*> &objects, Vector *target_ray);
-
-float *color_pixel (Object *target, Vector *target_ray,
-                    vector<Object*> &objects,
-                    vector<Light*> &lights,
-                    Properties *properties,
-                    int **pixels, int pixel_index,
-                    vector<float> &refraction_indices, int depth);
-
-float sum_lights (Object *target, vector<Object*> &objects, vector<Light*> &lights,
-                  Properties *properties, Intersection *intersection,
-                  float (&color)[3], int rgb_index);
-
-#endif
+#ifndef CASTING_H_
+#define CASTING_H_
+
+#include <cstdlib>
+#include <vector>
+
+#include "Properties.h"
+#include "Vectors.h"
+#include "Objects.h"
+#include "Lights.h"
+#include "Accelerators.h"
+
+using namespace std;
+
+// These resolve cyclical includes.
+class Object;
+class Light;
+class Light_tree;
+class Accelerator;
+struct Properties;
+struct Wavefront;
+
+// These macros allow for easy adjustment of shadows for the entire program.
+#define SOFT_SHADOWS 0  // This macro toggles soft shadows on and off.
+#define MAX_SHADOW_RAYS 100  // When soft shadows are enabled, this many rays are produced.
+#define OFFSET_MAX 0.015
+#define OFFSET_MIN -0.015
+#define SHADOW_BIAS 0.001
+
+#define LIGHT_SAMPLE_SEED 2463534242u  // Sampled lights and soft shadows are drawn with this seed, so that renders can be repeated.
+#define RANDOM_LIGHT_CHOICE 0xFFFFFFFFu  // This takes the place of a light's index for the numbers that choose sampled lights.
+
+#define MAX_DEPTH 5  // This is a hard cap on the number of reflection/transparency recursions allowed.
+
+// This function returns the number of shadow rays traced toward each light from each shaded point.
+inline int shadow_ray_count () {
+  return SOFT_SHADOWS ? MAX_SHADOW_RAYS : 1;
+}
+
+// A hit is recorded once while the accelerator searches for it, and then shared by every step of shading.
+// Objects only fill in the distance, primitive, and barycentric weights while searching, since most hits are later
+// replaced by closer ones. The rest is filled in by complete_hit once the closest hit is known.
+struct Intersection {
+  float distance;  // This is how far along the ray the hit lies.
+  Vec3 point;
+  Vec3 normal;  // This is the unit normal used for shading, which is interpolated across smooth triangles.
+  Vec3 geometric_normal;  // This is the unit normal of the surface itself, turned to the same side as the shading normal.
+  float barycentric[3];  // These are the weights of a triangle's three vertices at the hit.
+  Object *primitive;  // This is the object that was actually hit, which differs from the target for mesh instances.
+};
+
+// Colors are returned by value from every level of recursion, so shading never allocates memory.
+struct Color {
+  float r;
+  float g;
+  float b;
+};
+
+// Each recursion adds at most one index of refraction to the stack below, so it never holds more than this many.
+#define REFRACTION_STACK_SIZE (MAX_DEPTH + 1)
+
+// This stack holds the indices of refraction of the objects that a ray is inside of, with the innermost last.
+// A ray that leaves an object that it never entered, such as the back of a lone triangle, is treated as being back
+// in the scene's medium, so the count can drop below the number of indices stored.
+struct Refraction_stack {
+  float indices[REFRACTION_STACK_SIZE];
+  int size;
+  float scene_index;
+
+  Refraction_stack (float index) : size(1), scene_index(index) {indices[0] = index;}
+
+  void push (float index) {
+    if (size >= 0) {
+      indices[size] = index;
+    }
+    size++;
+  }
+  void pop () {size--;}
+  float back () {return size > 0 ? indices[size - 1] : scene_index;}
+};
+
+// This describes the rays that leave a shaded point and how much of each one's color the point takes.
+// Each ray starts inside of its own copy of the indices of refraction, which begins as the incoming ray's.
+struct Scattering {
+  Ray reflection_ray;
+  Ray transmitted_ray;
+  bool transmits;  // This is false when the transmitted ray is lost to total internal reflection.
+  float reflection_weight;  // This is the Fresnel reflectance.
+  float transmission_weight;  // This is the light that is neither reflected nor stopped by the surface's opacity.
+  Refraction_stack reflection_indices;
+  Refraction_stack transmission_indices;
+
+  Scattering (const Refraction_stack &indices) : reflection_indices(indices), transmission_indices(indices) {}
+};
+
+// This names a light to shade at a point and how much its illumination is weighted by.
+struct Light_choice {
+  int light;
+  float weight;
+  int sample;  // This is the number of the sample that chose the light, or 0 if the light wasn't sampled.
+};
+
+// Each light remembers the last object that blocked one of its shadow rays, since nearby points are usually blocked by the same object.
+struct Shadow_cache {
+  Object *occluder;
+  long lookups;
+  long hits;
+};
+
+// Random numbers are found by hashing a key that names what they are used for, instead of by stepping a generator.
+// The same sample always gets the same number, no matter which thread draws it or in what order the tiles are rendered.
+struct Random_key {
+  unsigned int pixel;
+  unsigned int frame;
+  unsigned int path;  // This starts at 1 and gains a 0 bit for each reflection and a 1 bit for each transmission.
+};
+
+// This function scrambles the bits of an integer, so that keys differing in a single bit give unrelated results.
+inline unsigned int hash_bits (unsigned int x) {
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return x;
+}
+
+// This function returns a random number in [0, 1) for the given sample of a light at the point named by the key.
+inline float random_number (const Random_key &key, unsigned int light, unsigned int sample) {
+  unsigned int x = hash_bits(LIGHT_SAMPLE_SEED ^ key.pixel);
+  x = hash_bits(x ^ key.frame);
+  x = hash_bits(x ^ key.path);
+  x = hash_bits(x ^ light);
+  x = hash_bits(x ^ sample);
+  return (x >> 8)*(1.0f/16777216.0f);
+}
+
+// This holds the state that each rendering thread keeps for itself.
+struct Render_state {
+  vector<Shadow_cache> shadow_caches;  // There is one cache for each of the scene's lights, in the same order.
+  vector<int> selected_lights;  // This lists the lights that may light the point being shaded.
+  vector<Light_choice> light_choices;  // This lists the lights that are shaded at the point, with their weights.
+  long closest_queries;  // Shadow queries are counted by the shadow caches instead.
+  long light_gathers;
+  long lights_gathered;
+  Random_key key;  // This names the point being shaded, for the random numbers used to shade it.
+  Wavefront *wavefront;  // This holds the wavefront engine's queues, which are reused by every batch the thread renders.
+};
+
+void init_render_state(Render_state *state, vector<Light*> &lights);
+void free_render_state(Render_state *state);
+
+Accelerator *build_accelerator(vector<Object*> &objects, int type);
+
+Object *closest_intersection(Accelerator *accelerator, const Ray &target_ray, Intersection &hit, Render_state *state);
+
+int closest_intersections(Accelerator *accelerator, const Ray_packet &packet, int mask, Intersection (&hits)[PACKET_SIZE],
+                          Object *(&contacts)[PACKET_SIZE], Render_state *state);
+
+float cached_occlusion(Accelerator *accelerator, const Ray &shadow_ray, float tmax, Shadow_cache &cache);
+
+void cached_occlusions(Accelerator *accelerator, const Ray *shadow_rays, const float *tmax, int count, Shadow_cache &cache, float *passes);
+
+float cached_occlusion_sum(Accelerator *accelerator, Ray *shadow_rays, float *tmax, int count, Shadow_cache &cache);
+
+void surface_color(Object *target, const Intersection &hit, float (&color)[3]);
+
+void scatter_rays(Object *target, const Ray &target_ray, const Intersection &hit, Scattering &scattering);
+
+void own_light(Object *target, float (&color)[3], float (&light_sum)[3], float (&own)[3]);
+
+Color blend_colors(float (&own)[3], float reflection_weight, const Color &reflected, float transmission_weight, const Color &transmitted);
+
+Color clamp_color(float (&own)[3]);
+
+Color color_pixel (Object *target, const Ray &target_ray, const Intersection &hit,
+                   Accelerator *accelerator, Light_tree *light_tree,
+                   Properties *properties,
+                   Refraction_stack &refraction_indices, Render_state *state, int depth);
+
+void sum_lights (Object *target, Accelerator *accelerator, Light_tree *light_tree,
+                 Properties *properties, const Intersection &hit,
+                 float (&color)[3], float (&sum)[3], Render_state *state);
+
+void choose_lights(Light_tree *light_tree, Properties *properties, const Intersection &hit, Render_state *state,
+                   vector<Light_choice> &choices);
+
+void add_illumination(Object *target, Light *light, const Intersection &hit, Vec3 v, float (&color)[3], float (&sum)[3],
+                      float weight, float shadow_constant);
+
+#endif
@@ -0,0 +1,656 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <csignal>
+#include <climits>
+#include <cerrno>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "Daemon.h"
+#include "Distributed.h"
+#include "Render.h"
+#include "Vectors.h"
+#include "Objects.h"
+#include "Lights.h"
+#include "Casting.h"
+#include "Properties.h"
+#include "Accelerators.h"
+
+using namespace std;
+
+// This is set by SIGINT or SIGTERM, and stops the daemon once the running job's current batch of tiles is done.
+static volatile sig_atomic_t stopping = 0;
+
+static void stop_daemon (int signal_number) {
+  stopping = 1;
+}
+
+// This function fills in the address of a Unix domain socket, and returns false if the path is too long for one.
+static bool socket_address (const char *socket_path, sockaddr_un &address) {
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(socket_path) >= sizeof(address.sun_path)) {
+    printf("The socket path \"%s\" is too long. Please choose a shorter path.\n", socket_path);
+    return false;
+  }
+  strcpy(address.sun_path, socket_path);
+  return true;
+}
+
+// This function replaces a scene's properties with the scene file lines in overrides, which are checked the same way
+// that the scene file's lines are. It returns false and describes the first line that can't be used otherwise.
+static bool apply_overrides (Properties *properties, const char *overrides, char *reason, size_t reason_size) {
+  const char *line = overrides;
+  while (*line != '\0') {
+    const char *end = strchr(line, '\n');
+    if (end == NULL) {
+      end = line + strlen(line);
+    }
+    vector<char> current(line, end);
+    current.push_back('\0');
+    line = *end == '\0' ? end : end + 1;
+
+    char keyword[13];
+    int used;
+    if (sscanf(&current[0], "%12s%n", keyword, &used) != 1) {
+      continue;
+    }
+    const char *values = &current[used];
+    char name[13];
+    bool valid;
+    if (strcmp(keyword, "eye") == 0) {
+      valid = sscanf(values, "%f %f %f", &properties->eye[0], &properties->eye[1], &properties->eye[2]) == 3;
+    }
+    else if (strcmp(keyword, "viewdir") == 0) {
+      valid = sscanf(values, "%f %f %f", &properties->viewdir[0], &properties->viewdir[1], &properties->viewdir[2]) == 3 &&
+              (properties->viewdir[0] != 0 || properties->viewdir[1] != 0 || properties->viewdir[2] != 0);
+    }
+    else if (strcmp(keyword, "updir") == 0) {
+      valid = sscanf(values, "%f %f %f", &properties->updir[0], &properties->updir[1], &properties->updir[2]) == 3 &&
+              (properties->updir[0] != 0 || properties->updir[1] != 0 || properties->updir[2] != 0);
+    }
+    else if (strcmp(keyword, "vfov") == 0) {
+      valid = sscanf(values, "%f", &properties->vfov) == 1 && properties->vfov > 0 && properties->vfov < 180;
+    }
+    else if (strcmp(keyword, "imsize") == 0) {
+      valid = sscanf(values, "%d %d", &properties->imsize[0], &properties->imsize[1]) == 2 &&
+              properties->imsize[0] > 0 && properties->imsize[1] > 0;
+    }
+    else if (strcmp(keyword, "bkgcolor") == 0) {
+      valid = sscanf(values, "%f %f %f", &properties->bkgcolor[0], &properties->bkgcolor[1], &properties->bkgcolor[2]) == 3;
+      for (int i = 0; i < 3; i++) {
+        valid = valid && properties->bkgcolor[i] >= 0 && properties->bkgcolor[i] <= 1;
+      }
+    }
+    else if (strcmp(keyword, "accel") == 0) {
+      valid = sscanf(values, "%12s", name) == 1 && (strcmp(name, "bvh") == 0 || strcmp(name, "grid") == 0);
+      if (valid) {
+        properties->accelerator = strcmp(name, "bvh") == 0 ? ACCEL_BVH : ACCEL_GRID;
+      }
+    }
+    else if (strcmp(keyword, "engine") == 0) {
+      valid = sscanf(values, "%12s", name) == 1 && (strcmp(name, "recursive") == 0 || strcmp(name, "wavefront") == 0);
+      if (valid) {
+        properties->engine = strcmp(name, "recursive") == 0 ? ENGINE_RECURSIVE : ENGINE_WAVEFRONT;
+      }
+    }
+    else if (strcmp(keyword, "frames") == 0) {
+      valid = sscanf(values, "%d", &properties->frames) == 1 && properties->frames >= 1;
+    }
+    else if (strcmp(keyword, "lightcutoff") == 0) {
+      valid = sscanf(values, "%f", &properties->light_cutoff) == 1 && properties->light_cutoff >= 0;
+    }
+    else if (strcmp(keyword, "lightsamples") == 0) {
+      valid = sscanf(values, "%d", &properties->light_samples) == 1 && properties->light_samples >= 0;
+    }
+    else {
+      snprintf(reason, reason_size, "Sorry, \"%s\" can't be changed between renders.", keyword);
+      return false;
+    }
+    if (!valid) {
+      snprintf(reason, reason_size, "The values of \"%s\" are not valid. Please fix them and try again.", &current[0]);
+      return false;
+    }
+  }
+
+  Vec3 updir = {properties->updir[0], properties->updir[1], properties->updir[2]};
+  Vec3 viewdir = {properties->viewdir[0], properties->viewdir[1], properties->viewdir[2]};
+  if (vector_length(cross_product(updir, viewdir)) == 0) {
+    snprintf(reason, reason_size, "The up and viewing directions are paralell to each other. Please fix this error and try again.");
+    return false;
+  }
+  return true;
+}
+
+// This function frees a resident scene along with its accelerators.
+static void forget_scene (Daemon &daemon, int index) {
+  Resident_scene *scene = daemon.scenes[index];
+  delete scene->accelerators[ACCEL_BVH];
+  delete scene->accelerators[ACCEL_GRID];
+  delete scene->light_tree;
+  delete_meshes(scene->meshes);
+  delete scene;
+  daemon.scenes.erase(daemon.scenes.begin() + index);
+}
+
+// This function returns true if none of a resident scene's textures have been modified or removed since it was scanned.
+static bool textures_unchanged (Resident_scene *scene) {
+  for (unsigned int i = 0; i < scene->textures.size(); i++) {
+    struct stat info;
+    if (stat(&scene->textures[i].path[0], &info) != 0 || info.st_mtime != scene->textures[i].modified) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// This function finds a job's scene among the resident scenes, or scans it if it isn't there. A resident scene is
+// scanned again if its file or one of its textures was modified, or if its animated objects were moved by an earlier job. Scanning a scene
+// reuses every cached texture that hasn't changed, and may forget the least recently used scene to make room.
+static Resident_scene *load_scene (Daemon &daemon, Render_job &job, bool &reused, char *reason, size_t reason_size) {
+  reused = false;
+  if (chdir(&job.directory[0]) != 0) {
+    snprintf(reason, reason_size, "Sorry, the daemon could not enter the directory \"%s\".", &job.directory[0]);
+    return NULL;
+  }
+  char *full_path = realpath(&job.scene[0], NULL);
+  struct stat info;
+  if (full_path == NULL || stat(full_path, &info) != 0) {
+    free(full_path);
+    snprintf(reason, reason_size, "Sorry, the file \"%s\" could not be opened.", &job.scene[0]);
+    return NULL;
+  }
+
+  for (unsigned int i = 0; i < daemon.scenes.size(); i++) {
+    Resident_scene *scene = daemon.scenes[i];
+    if (strcmp(&scene->directory[0], &job.directory[0]) == 0 && strcmp(&scene->path[0], full_path) == 0) {
+      if (scene->modified == info.st_mtime && scene->frame == 0 && textures_unchanged(scene)) {
+        free(full_path);
+        reused = true;
+        return scene;
+      }
+      forget_scene(daemon, i);
+      break;
+    }
+  }
+
+  FILE *file_ptr = fopen(full_path, "r");
+  if (file_ptr == NULL) {
+    free(full_path);
+    snprintf(reason, reason_size, "Sorry, the file \"%s\" could not be opened.", &job.scene[0]);
+    return NULL;
+  }
+  printf("Scanning %s for job %d...\n\n", full_path, job.number);
+  Resident_scene *scene = new Resident_scene;
+  scene->directory = job.directory;
+  scene->path.assign(full_path, full_path + strlen(full_path) + 1);
+  scene->modified = info.st_mtime;
+  scene->accelerators[ACCEL_BVH] = NULL;
+  scene->accelerators[ACCEL_GRID] = NULL;
+  scene->light_tree = NULL;
+  scene->frame = 0;
+  free(full_path);
+  daemon.textures.used.clear();
+  int failure_test = extract_info(file_ptr, &scene->properties, scene->objects, scene->lights, scene->arena, scene->store,
+                                  scene->meshes, scene->motions, &daemon.textures);
+  fclose(file_ptr);
+  scene->textures = daemon.textures.used;
+  if (failure_test) {
+    delete_meshes(scene->meshes);
+    delete scene;
+    snprintf(reason, reason_size, "Sorry, the file \"%s\" could not be scanned. The daemon's output explains why.", &job.scene[0]);
+    return NULL;
+  }
+  scene->light_tree = new Light_tree(scene->lights);
+
+  while (daemon.scenes.size() >= DAEMON_MAX_SCENES) {
+    int oldest = 0;
+    for (unsigned int i = 1; i < daemon.scenes.size(); i++) {
+      if (daemon.scenes[i]->last_used < daemon.scenes[oldest]->last_used) {
+        oldest = i;
+      }
+    }
+    forget_scene(daemon, oldest);
+  }
+  daemon.scenes.push_back(scene);
+  return scene;
+}
+
+// This function returns the socket of a client, or -1 if the client has left.
+static int client_socket (Daemon &daemon, int client) {
+  for (unsigned int i = 0; i < daemon.clients.size(); i++) {
+    if (daemon.clients[i].number == client) {
+      return daemon.clients[i].socket;
+    }
+  }
+  return -1;
+}
+
+// This function sends a message to a client, and returns false if the client has left. A client that stops reading
+// is shut out once a send times out, since part of a message may have been sent. Its socket then reads as closed, so
+// it is dropped the next time that clients are served, and nothing more is sent to it.
+static bool send_to_client (Daemon &daemon, int client, const vector<char> &message) {
+  int socket = client_socket(daemon, client);
+  if (socket == -1) {
+    return false;
+  }
+  if (!send_all(socket, message)) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      printf("A client stopped reading what the daemon sent, so it was dropped.\n");
+    }
+    shutdown(socket, SHUT_RDWR);
+    return false;
+  }
+  return true;
+}
+
+// This function tells a client how one of its jobs ended.
+static void send_finished (Daemon &daemon, int client, int job, int status, const char *line) {
+  vector<char> message;
+  size_t start = start_message(message, MESSAGE_FINISHED);
+  put_int(message, job);
+  put_int(message, status);
+  message.insert(message.end(), line, line + strlen(line) + 1);
+  finish_message(message, start);
+  send_to_client(daemon, client, message);
+}
+
+// A waiting job is dropped at once, and the running job stops after its current batch of tiles. Anyone may cancel a
+// job, and whoever asked is told whether there was a job to cancel.
+static void cancel_job (Daemon &daemon, int number, int requester) {
+  char line[100];
+  snprintf(line, sizeof(line), "Job %d was cancelled.", number);
+  for (unsigned int i = 0; i < daemon.jobs.size(); i++) {
+    if (daemon.jobs[i].number == number) {
+      int client = daemon.jobs[i].client;
+      daemon.jobs.erase(daemon.jobs.begin() + i);
+      printf("Job %d was cancelled before it started.\n", number);
+      send_finished(daemon, client, number, JOB_CANCELLED, line);
+      if (requester != client) {
+        send_finished(daemon, requester, number, JOB_DONE, line);
+      }
+      return;
+    }
+  }
+  if (daemon.running != NULL && daemon.running->number == number) {
+    daemon.running->cancelled = true;
+    if (requester != daemon.running->client) {
+      send_finished(daemon, requester, number, JOB_DONE, line);
+    }
+    return;
+  }
+  snprintf(line, sizeof(line), "Sorry, there is no job %d waiting or running.", number);
+  send_finished(daemon, requester, number, JOB_FAILED, line);
+}
+
+// A client that leaves takes its jobs with it.
+static void drop_client (Daemon &daemon, int index) {
+  int client = daemon.clients[index].number;
+  for (int i = (int)daemon.jobs.size() - 1; i >= 0; i--) {
+    if (daemon.jobs[i].client == client) {
+      printf("Job %d was dropped because its client left.\n", daemon.jobs[i].number);
+      daemon.jobs.erase(daemon.jobs.begin() + i);
+    }
+  }
+  if (daemon.running != NULL && daemon.running->client == client) {
+    daemon.running->cancelled = true;
+  }
+  close(daemon.clients[index].socket);
+  daemon.clients.erase(daemon.clients.begin() + index);
+}
+
+// This function handles every whole message that a client has sent, and returns false if one can't be read.
+static bool read_requests (Daemon &daemon, Daemon_client &client) {
+  size_t used = 0;
+  while (client.input.size() - used >= sizeof(int)) {
+    int length = get_int(&client.input[used], 0);
+    if (length < (int)sizeof(int) || length > DAEMON_MAX_MESSAGE) {
+      return false;
+    }
+    if (client.input.size() - used - sizeof(int) < (size_t)length) {
+      break;
+    }
+    const char *body = &client.input[used + sizeof(int)];
+    int kind = get_int(body, 0);
+    used += sizeof(int) + length;
+
+    if (kind == MESSAGE_JOB && length >= 2*(int)sizeof(int)) {
+      // The directory, scene, and overrides must each end with a '\0' inside of the message.
+      const char *text[3];
+      const char *c = body + 2*sizeof(int);
+      const char *end = body + length;
+      for (int i = 0; i < 3; i++) {
+        const char *terminator = c < end ? (const char*)memchr(c, '\0', end - c) : NULL;
+        if (terminator == NULL) {
+          return false;
+        }
+        text[i] = c;
+        c = terminator + 1;
+      }
+      Render_job job;
+      job.number = daemon.next_job++;
+      job.priority = get_int(body, 4);
+      job.client = client.number;
+      job.directory.assign(text[0], text[0] + strlen(text[0]) + 1);
+      job.scene.assign(text[1], text[1] + strlen(text[1]) + 1);
+      job.overrides.assign(text[2], text[2] + strlen(text[2]) + 1);
+      job.cancelled = false;
+      daemon.jobs.push_back(job);
+      printf("Job %d was queued with priority %d: %s\n", job.number, job.priority, text[1]);
+
+      vector<char> message;
+      size_t start = start_message(message, MESSAGE_QUEUED);
+      put_int(message, job.number);
+      finish_message(message, start);
+      send_all(client.socket, message);
+    }
+    else if (kind == MESSAGE_CANCEL && length == 2*sizeof(int)) {
+      cancel_job(daemon, get_int(body, 4), client.number);
+    }
+    else {
+      return false;
+    }
+  }
+  client.input.erase(client.input.begin(), client.input.begin() + used);
+  return true;
+}
+
+// This function accepts new clients and handles their messages. It waits up to timeout milliseconds for something to
+// happen, or forever if timeout is -1.
+static void serve_clients (Daemon &daemon, int timeout) {
+  vector<pollfd> polled(1 + daemon.clients.size());
+  polled[0].fd = daemon.listener;
+  polled[0].events = POLLIN;
+  for (unsigned int c = 0; c < daemon.clients.size(); c++) {
+    polled[1 + c].fd = daemon.clients[c].socket;
+    polled[1 + c].events = POLLIN;
+  }
+  if (poll(&polled[0], polled.size(), timeout) <= 0) {
+    return;
+  }
+
+  //Clients are checked from the back, so that dropping one doesn't move the ones still to be checked.
+  for (int c = (int)daemon.clients.size() - 1; c >= 0; c--) {
+    if (!(polled[1 + c].revents & (POLLIN | POLLHUP | POLLERR))) {
+      continue;
+    }
+    char buffer[DIST_READ_SIZE];
+    ssize_t received = recv(daemon.clients[c].socket, buffer, sizeof(buffer), 0);
+    if (received <= 0) {
+      drop_client(daemon, c);
+      continue;
+    }
+    daemon.clients[c].input.insert(daemon.clients[c].input.end(), buffer, buffer + received);
+    if (!read_requests(daemon, daemon.clients[c])) {
+      drop_client(daemon, c);
+    }
+  }
+
+  if (polled[0].revents & POLLIN) {
+    int socket = accept(daemon.listener, NULL, NULL);
+    if (socket != -1) {
+      timeval timeout = {DAEMON_SEND_TIMEOUT, 0};
+      setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+      Daemon_client client;
+      client.number = daemon.next_client++;
+      client.socket = socket;
+      daemon.clients.push_back(client);
+    }
+  }
+}
+
+// A job's tiles are rendered a batch at a time, and each batch is sent to the client as soon as it is done. New
+// messages are handled between batches, so that jobs can be queued or cancelled while another job runs. The scene's
+// accelerator is built the first time that it's needed, and kept with the scene for later jobs.
+static void run_job (Daemon &daemon, Render_job &job) {
+  chrono::steady_clock::time_point job_start = chrono::steady_clock::now();
+  char reason[PATH_MAX + 200];
+  bool reused;
+  Resident_scene *scene = load_scene(daemon, job, reused, reason, sizeof(reason));
+  if (scene == NULL) {
+    printf("Job %d failed. %s\n", job.number, reason);
+    send_finished(daemon, job.client, job.number, JOB_FAILED, reason);
+    return;
+  }
+  scene->last_used = ++daemon.clock;
+
+  Properties properties = scene->properties;
+  if (!apply_overrides(&properties, &job.overrides[0], reason, sizeof(reason))) {
+    printf("Job %d failed. %s\n", job.number, reason);
+    send_finished(daemon, job.client, job.number, JOB_FAILED, reason);
+    return;
+  }
+  bool built = scene->accelerators[properties.accelerator] == NULL;
+  if (built) {
+    scene->accelerators[properties.accelerator] = build_accelerator(scene->objects, properties.accelerator);
+  }
+  Accelerator *accelerator = scene->accelerators[properties.accelerator];
+
+  Camera camera;
+  setup_camera(&properties, camera);
+  vector<float> pixels(3*(size_t)properties.imsize[0]*properties.imsize[1]);
+  vector<Render_state> states(daemon.threads);
+  for (int t = 0; t < daemon.threads; t++) {
+    init_render_state(&states[t], scene->lights);
+  }
+  Render_stats stats = {0, 0};
+
+  vector<char> message;
+  size_t start = start_message(message, MESSAGE_STARTED);
+  put_int(message, job.number);
+  put_int(message, properties.imsize[0]);
+  put_int(message, properties.imsize[1]);
+  put_int(message, properties.frames);
+  finish_message(message, start);
+  bool connected = send_to_client(daemon, job.client, message);
+
+  int count = tile_count(&properties);
+  int batch_size = DAEMON_BATCH_TILES*daemon.threads;
+  vector<int> batch;
+  for (int frame = 0; frame < properties.frames && connected && !job.cancelled; frame++) {
+
+    //Moving the animated objects leaves the other accelerator behind, so it is forgotten, and the scene will be
+    //scanned again by the next job that asks for it.
+    if (frame > 0 && !scene->motions.empty()) {
+      int other = properties.accelerator == ACCEL_BVH ? ACCEL_GRID : ACCEL_BVH;
+      delete scene->accelerators[other];
+      scene->accelerators[other] = NULL;
+      advance_frame(scene->motions, scene->store, scene->meshes, accelerator);
+      scene->frame = frame;
+    }
+
+    for (int first = 0; first < count && connected && !job.cancelled; first += batch_size) {
+      batch.clear();
+      for (int tile = first; tile < min(first + batch_size, count); tile++) {
+        batch.push_back(tile);
+      }
+      render_tiles(camera, accelerator, scene->light_tree, &properties, frame, batch, states, pixels, stats);
+      message.clear();
+      for (unsigned int i = 0; i < batch.size(); i++) {
+        put_tile(message, &properties, frame, batch[i], pixels);
+      }
+      connected = send_to_client(daemon, job.client, message);
+      serve_clients(daemon, 0);
+      if (stopping) {
+        job.cancelled = true;
+      }
+    }
+
+    if (connected && !job.cancelled) {
+      message.clear();
+      start = start_message(message, MESSAGE_FRAME);
+      put_int(message, frame);
+      finish_message(message, start);
+      connected = send_to_client(daemon, job.client, message);
+    }
+  }
+
+  for (int t = 0; t < daemon.threads; t++) {
+    free_render_state(&states[t]);
+  }
+
+  double job_time = chrono::duration<double>(chrono::steady_clock::now() - job_start).count();
+  if (!connected || job.cancelled) {
+    snprintf(reason, sizeof(reason), "Job %d was cancelled.", job.number);
+    printf("%s\n", reason);
+    send_finished(daemon, job.client, job.number, JOB_CANCELLED, reason);
+    return;
+  }
+  snprintf(reason, sizeof(reason), "Job %d rendered %d frame%s of %dx%d pixels in %.3f s (scene %s, accelerator %s).",
+           job.number, properties.frames, properties.frames == 1 ? "" : "s", properties.imsize[0], properties.imsize[1],
+           job_time, reused ? "resident" : "scanned", built ? "built" : "resident");
+  printf("%s\n", reason);
+  send_finished(daemon, job.client, job.number, JOB_DONE, reason);
+}
+
+// The daemon listens on a Unix domain socket, and renders one job at a time with every rendering thread. Between jobs,
+// it waits for messages, so clients are answered at once even while no job is running. It runs until it is stopped
+// with SIGINT or SIGTERM, and then removes its socket.
+int run_daemon (const char *socket_path, int threads) {
+  sockaddr_un address;
+  if (!socket_address(socket_path, address)) {
+    return 1;
+  }
+
+  //A socket left behind by a daemon that was killed is replaced, but a daemon that is still answering is left alone.
+  struct stat info;
+  if (stat(socket_path, &info) == 0) {
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool answering = probe != -1 && connect(probe, (sockaddr*)&address, sizeof(address)) == 0;
+    if (probe != -1) {
+      close(probe);
+    }
+    if (answering || !S_ISSOCK(info.st_mode)) {
+      printf("Sorry, \"%s\" is already in use. Please choose another socket path.\n", socket_path);
+      return 1;
+    }
+    unlink(socket_path);
+  }
+
+  Daemon daemon;
+  daemon.listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (daemon.listener == -1 || bind(daemon.listener, (sockaddr*)&address, sizeof(address)) != 0 ||
+      listen(daemon.listener, DIST_BACKLOG) != 0) {
+    printf("Sorry, the daemon could not listen on \"%s\".\n", socket_path);
+    return 1;
+  }
+  daemon.threads = render_threads(threads);
+  daemon.running = NULL;
+  daemon.next_client = 1;
+  daemon.next_job = 1;
+  daemon.clock = 0;
+
+  //Polling is interrupted by these signals, rather than restarted, so that the daemon stops even while it is idle.
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = stop_daemon;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  //The daemon's output is usually sent to a log, which is written a line at a time so that it can be followed.
+  setvbuf(stdout, NULL, _IOLBF, 0);
+  printf("The render daemon is waiting for jobs on \"%s\" with %d thread%s.\n\n", socket_path, daemon.threads,
+         daemon.threads == 1 ? "" : "s");
+  while (!stopping) {
+    serve_clients(daemon, daemon.jobs.empty() ? -1 : 0);
+    if (daemon.jobs.empty() || stopping) {
+      continue;
+    }
+
+    int next = 0;
+    for (unsigned int i = 1; i < daemon.jobs.size(); i++) {
+      if (daemon.jobs[i].priority > daemon.jobs[next].priority) {
+        next = i;
+      }
+    }
+    Render_job job = daemon.jobs[next];
+    daemon.jobs.erase(daemon.jobs.begin() + next);
+    daemon.running = &job;
+    run_job(daemon, job);
+    daemon.running = NULL;
+
+    //Textures can't be freed one at a time, so once they take too much memory, they are all forgotten together with
+    //the scenes that use them.
+    if (daemon.textures.arena.bytes_used() > DAEMON_TEXTURE_MEMORY) {
+      while (!daemon.scenes.empty()) {
+        forget_scene(daemon, 0);
+      }
+      daemon.textures.textures.clear();
+      daemon.textures.arena.release();
+    }
+  }
+
+  printf("\nThe render daemon is stopping.\n");
+  for (unsigned int i = 0; i < daemon.jobs.size(); i++) {
+    send_finished(daemon, daemon.jobs[i].client, daemon.jobs[i].number, JOB_CANCELLED, "The render daemon stopped.");
+  }
+  for (unsigned int c = 0; c < daemon.clients.size(); c++) {
+    close(daemon.clients[c].socket);
+  }
+  while (!daemon.scenes.empty()) {
+    forget_scene(daemon, 0);
+  }
+  close(daemon.listener);
+  unlink(socket_path);
+  return 0;
+}
+
+// This function connects to a render daemon, and returns the connected socket or -1 if there is no daemon.
+int connect_daemon (const char *socket_path) {
+  sockaddr_un address;
+  if (!socket_address(socket_path, address)) {
+    return -1;
+  }
+  int connected = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (connected == -1 || connect(connected, (sockaddr*)&address, sizeof(address)) != 0) {
+    if (connected != -1) {
+      close(connected);
+    }
+    printf("Sorry, no render daemon is waiting on \"%s\".\n", socket_path);
+    return -1;
+  }
+  return connected;
+}
+
+// The scene's path is sent as it was given, along with the client's working directory, so that the daemon finds the
+// scene and its textures wherever the client would have.
+bool send_job (int socket, const char *scene, const vector<char> &overrides, int priority) {
+  char *directory = getcwd(NULL, 0);
+  if (directory == NULL) {
+    printf("Sorry, the current directory could not be found.\n");
+    return false;
+  }
+  vector<char> message;
+  size_t start = start_message(message, MESSAGE_JOB);
+  put_int(message, priority);
+  message.insert(message.end(), directory, directory + strlen(directory) + 1);
+  message.insert(message.end(), scene, scene + strlen(scene) + 1);
+  message.insert(message.end(), overrides.begin(), overrides.end());
+  message.push_back('\0');
+  finish_message(message, start);
+  free(directory);
+  if (message.size() > DAEMON_MAX_MESSAGE) {
+    printf("Sorry, the job is too long to send to the daemon.\n");
+    return false;
+  }
+  return send_all(socket, message);
+}
+
+// This function asks the daemon to cancel a job.
+bool send_cancel (int socket, int job) {
+  vector<char> message;
+  size_t start = start_message(message, MESSAGE_CANCEL);
+  put_int(message, job);
+  finish_message(message, start);
+  return send_all(socket, message);
+}
@@ -0,0 +1,106 @@
+#ifndef DAEMON_H_
+#define DAEMON_H_
+
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+#include "Objects.h"
+#include "Lights.h"
+#include "Properties.h"
+#include "Accelerators.h"
+#include "Arena.h"
+
+using namespace std;
+
+// These resolve cyclical includes.
+class Object;
+class Light;
+class Light_tree;
+class Accelerator;
+struct Properties;
+
+// These macros control what the render daemon keeps between jobs and how often it checks for new messages.
+#define DAEMON_MAX_SCENES 4  // The daemon keeps this many scanned scenes, and forgets the least recently used one after that.
+#define DAEMON_TEXTURE_MEMORY (512 << 20)  // Once the cached textures take more than this many bytes, they are forgotten
+                                           // along with every scene that uses them.
+#define DAEMON_BATCH_TILES 4  // A job's tiles are rendered this many per thread at a time, and are sent back after each
+                              // batch. New messages are only answered between batches.
+#define DAEMON_MAX_MESSAGE 65536  // Clients may send messages of up to this many bytes.
+#define DAEMON_SEND_TIMEOUT 10  // A client that takes longer than this many seconds to make room for a message is
+                                // dropped, so that it can't stall the daemon.
+
+// These name the messages sent between the daemon and its clients, which are framed like the coordinator's messages
+// (see "Distributed.h"). Rendered tiles are returned as MESSAGE_PIXELS.
+#define MESSAGE_JOB 5  // A client gives a priority, then its working directory, scene path, and overrides as text.
+#define MESSAGE_CANCEL 6  // A client cancels a job by its number.
+#define MESSAGE_QUEUED 7  // The daemon gives a client the number of its job.
+#define MESSAGE_STARTED 8  // The daemon gives the image size and frame count of a job that it has started.
+#define MESSAGE_FRAME 9  // Every tile of the frame with this number has been sent.
+#define MESSAGE_FINISHED 10  // The daemon gives a job's status and a line describing it, and closes the job.
+
+// These are the statuses of finished jobs.
+#define JOB_DONE 0
+#define JOB_CANCELLED 1
+#define JOB_FAILED 2
+
+// A resident scene is everything that was scanned from one scene file, along with the accelerators built around it so
+// far. It is only reused if it was scanned from the same directory and neither the file nor its textures have been
+// modified since.
+struct Resident_scene {
+  vector<char> directory;
+  vector<char> path;
+  time_t modified;
+  vector<Cached_texture> textures;  // These are the textures that the scene uses, and when they were last modified.
+  Properties properties;
+  vector<Object*> objects;
+  vector<Light*> lights;
+  Arena arena;
+  Triangle_store store;
+  vector<Mesh*> meshes;
+  vector<Motion> motions;
+  Accelerator *accelerators[2];  // These are indexed by ACCEL_BVH and ACCEL_GRID, and are built when first needed.
+  Light_tree *light_tree;
+  int frame;  // This is the frame that the animated objects were last moved to.
+  long last_used;
+};
+
+// A job asks for one scene to be rendered, with some of its properties replaced.
+struct Render_job {
+  int number;
+  int priority;  // Jobs with higher priorities are started first, and jobs with the same priority are started in order.
+  int client;
+  vector<char> directory;
+  vector<char> scene;
+  vector<char> overrides;  // This holds scene file lines, such as "eye 0 0 5" or "imsize 320 240".
+  bool cancelled;
+};
+
+// This is the daemon's connection to one client. Clients are named by number, so that a job whose client has left
+// never writes to a socket that was handed to a newer client.
+struct Daemon_client {
+  int number;
+  int socket;
+  vector<char> input;
+};
+
+struct Daemon {
+  int listener;
+  int threads;
+  vector<Daemon_client> clients;
+  vector<Render_job> jobs;  // These are the jobs waiting to be started.
+  Render_job *running;
+  int next_client;
+  int next_job;
+  vector<Resident_scene*> scenes;
+  Texture_cache textures;
+  long clock;  // This counts jobs, and marks when each scene was last used.
+};
+
+int run_daemon(const char *socket_path, int threads);
+
+int connect_daemon(const char *socket_path);
+bool send_job(int socket, const char *scene, const vector<char> &overrides, int priority);
+bool send_cancel(int socket, int job);
+
+#endif
@@ -0,0 +1,581 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <chrono>
+
+#include <unistd.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "Distributed.h"
+#include "Render.h"
+#include "Properties.h"
+
+using namespace std;
+
+// This is the longest message that a worker sends, which holds the pixels of one whole tile.
+#define MAX_MESSAGE_LENGTH (3*sizeof(int) + 3*TILE_SIZE*TILE_SIZE*sizeof(float))
+
+// This function adds an int to the end of a message.
+void put_int (vector<char> &message, int value) {
+  const char *bytes = (const char*)&value;
+  message.insert(message.end(), bytes, bytes + sizeof(int));
+}
+
+// This function reads the int at a byte offset of a message.
+int get_int (const char *data, size_t offset) {
+  int value;
+  memcpy(&value, data + offset, sizeof(int));
+  return value;
+}
+
+// This function starts a message of the given kind at the end of a buffer, and returns where it starts.
+// Its length is left as 0 until finish_message fills it in.
+size_t start_message (vector<char> &message, int kind) {
+  size_t start = message.size();
+  put_int(message, 0);
+  put_int(message, kind);
+  return start;
+}
+
+// This function fills in the length of the message that starts at the given position, once the rest has been added.
+void finish_message (vector<char> &message, size_t start) {
+  int length = (int)(message.size() - start - sizeof(int));
+  memcpy(&message[start], &length, sizeof(int));
+}
+
+// This function adds a message with the pixels of one tile to a buffer.
+void put_tile (vector<char> &message, Properties *properties, int frame, int tile, vector<float> &pixels) {
+  size_t start = start_message(message, MESSAGE_PIXELS);
+  put_int(message, frame);
+  put_int(message, tile);
+  int first_i, first_j, last_i, last_j;
+  tile_bounds(properties, tile, first_i, first_j, last_i, last_j);
+  for (int j = first_j; j < last_j; j++) {
+    const char *row = (const char*)&pixels[3*(first_i + (size_t)j*properties->imsize[0])];
+    message.insert(message.end(), row, row + 3*(last_i - first_i)*sizeof(float));
+  }
+  finish_message(message, start);
+}
+
+// This function copies the pixels of a tile message into the framebuffer, unless that tile is already done. The body
+// starts with the message's kind. It returns false if the message doesn't hold exactly one tile of this image.
+bool copy_tile (const char *body, size_t length, Properties *properties, vector<float> &pixels, vector<bool> &done) {
+  if (length < 3*sizeof(int)) {
+    return false;
+  }
+  int tile = get_int(body, 2*sizeof(int));
+  if (tile < 0 || tile >= (int)done.size()) {
+    return false;
+  }
+  int first_i, first_j, last_i, last_j;
+  tile_bounds(properties, tile, first_i, first_j, last_i, last_j);
+  size_t row_size = 3*(last_i - first_i)*sizeof(float);
+  if (length != 3*sizeof(int) + (last_j - first_j)*row_size) {
+    return false;
+  }
+  if (done[tile]) {
+    return true;
+  }
+  const char *row = body + 3*sizeof(int);
+  for (int j = first_j; j < last_j; j++) {
+    memcpy(&pixels[3*(first_i + (size_t)j*properties->imsize[0])], row, row_size);
+    row += row_size;
+  }
+  done[tile] = true;
+  return true;
+}
+
+// This function sends a whole buffer, and returns false if the connection was closed.
+// Writing to a closed socket fails instead of raising SIGPIPE, so a lost worker never stops the coordinator.
+bool send_all (int socket, const vector<char> &message) {
+  size_t sent = 0;
+  while (sent < message.size()) {
+    ssize_t count = send(socket, &message[sent], message.size() - sent, MSG_NOSIGNAL);
+    if (count <= 0) {
+      return false;
+    }
+    sent += count;
+  }
+  return true;
+}
+
+// This function waits for exactly size bytes, and returns false if the connection was closed first.
+static bool receive_all (int socket, char *data, size_t size) {
+  size_t received = 0;
+  while (received < size) {
+    ssize_t count = recv(socket, data + received, size - received, 0);
+    if (count <= 0) {
+      return false;
+    }
+    received += count;
+  }
+  return true;
+}
+
+// This function waits for a whole message and stores its body, which starts with its kind.
+bool receive_message (int socket, vector<char> &body) {
+  char length_bytes[sizeof(int)];
+  if (!receive_all(socket, length_bytes, sizeof(int))) {
+    return false;
+  }
+  int length = get_int(length_bytes, 0);
+  if (length < (int)sizeof(int)) {
+    return false;
+  }
+  body.resize(length);
+  return receive_all(socket, &body[0], length);
+}
+
+// This function reads a list of tiles such as "0-99,120,130-135" and adds them to the end of the list.
+// It returns false if the list can't be read.
+bool parse_tile_list (const char *list, vector<int> &tiles) {
+  const char *c = list;
+  while (*c != '\0') {
+    char *end;
+    long first = strtol(c, &end, 10);
+    if (end == c || first < 0) {
+      return false;
+    }
+    long last = first;
+    c = end;
+    if (*c == '-') {
+      c++;
+      last = strtol(c, &end, 10);
+      if (end == c || last < first) {
+        return false;
+      }
+      c = end;
+    }
+    for (long tile = first; tile <= last; tile++) {
+      tiles.push_back((int)tile);
+    }
+    if (*c == ',') {
+      c++;
+    }
+    else if (*c != '\0') {
+      return false;
+    }
+  }
+  return !tiles.empty();
+}
+
+// This function sets up a connection between a coordinator and a worker. Small messages are sent at once, and the
+// connection is closed if the other machine stops acknowledging what was sent or stops answering keepalive probes,
+// so that a machine that dies without closing its connection is noticed.
+static void set_up_link (int socket) {
+  int on = 1;
+  setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  setsockopt(socket, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+#ifdef TCP_KEEPIDLE
+  int idle = DIST_WORKER_TIMEOUT/4;
+  int interval = DIST_WORKER_TIMEOUT/8;
+  int probes = 2;
+  setsockopt(socket, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+  setsockopt(socket, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+  setsockopt(socket, IPPROTO_TCP, TCP_KEEPCNT, &probes, sizeof(probes));
+#endif
+#ifdef TCP_USER_TIMEOUT
+  unsigned int timeout = DIST_WORKER_TIMEOUT*1000;
+  setsockopt(socket, IPPROTO_TCP, TCP_USER_TIMEOUT, &timeout, sizeof(timeout));
+#endif
+}
+
+// This function returns when a worker that has just made progress must next be heard from.
+static chrono::steady_clock::time_point worker_deadline () {
+  return chrono::steady_clock::now() + chrono::seconds(DIST_WORKER_TIMEOUT);
+}
+
+// This function starts listening for workers on a port of every address of this machine.
+bool start_coordinator (Coordinator &coordinator, const char *port) {
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  addrinfo *addresses;
+  if (getaddrinfo(NULL, port, &hints, &addresses) != 0) {
+    printf("The port \"%s\" could not be used. Please choose another port.\n", port);
+    return false;
+  }
+
+  coordinator.listener = -1;
+  for (addrinfo *a = addresses; a != NULL && coordinator.listener == -1; a = a->ai_next) {
+    int listener = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if (listener == -1) {
+      continue;
+    }
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(listener, a->ai_addr, a->ai_addrlen) == 0 && listen(listener, DIST_BACKLOG) == 0) {
+      coordinator.listener = listener;
+    }
+    else {
+      close(listener);
+    }
+  }
+  freeaddrinfo(addresses);
+  if (coordinator.listener == -1) {
+    printf("Sorry, workers could not be waited for on port %s.\n", port);
+    return false;
+  }
+
+  coordinator.workers.clear();
+  coordinator.workers_lost = 0;
+  coordinator.tiles_reassigned = 0;
+  printf("Waiting for workers on port %s...\n\n", port);
+  return true;
+}
+
+// This function hands an idle worker the next few tiles of the frame.
+static bool hand_out (Worker_link &worker, deque<int> &pending, int frame) {
+  int count = min((int)pending.size(), DIST_BATCH_TILES);
+  vector<char> message;
+  size_t start = start_message(message, MESSAGE_TILES);
+  put_int(message, frame);
+  put_int(message, count);
+  for (int i = 0; i < count; i++) {
+    put_int(message, pending.front());
+    worker.tiles.push_back(pending.front());
+    pending.pop_front();
+  }
+  finish_message(message, start);
+  worker.deadline = worker_deadline();
+  return send_all(worker.socket, message);
+}
+
+// This function drops a worker whose connection was closed. Any tiles that it hadn't returned are put back at the
+// front of the queue, so the next idle worker renders them before anything else.
+static void lose_worker (Coordinator &coordinator, int index, deque<int> &pending, vector<bool> &done) {
+  Worker_link &worker = coordinator.workers[index];
+  int unfinished = 0;
+  for (vector<int>::reverse_iterator t = worker.tiles.rbegin(); t != worker.tiles.rend(); ++t) {
+    if (!done[*t]) {
+      pending.push_front(*t);
+      unfinished++;
+    }
+  }
+  if (worker.greeted) {
+    coordinator.workers_lost++;
+    coordinator.tiles_reassigned += unfinished;
+    printf("A worker was lost, so its %d unfinished tile%s will be handed to another worker.\n", unfinished,
+           unfinished == 1 ? "" : "s");
+  }
+  close(worker.socket);
+  coordinator.workers.erase(coordinator.workers.begin() + index);
+}
+
+// This function handles every whole message that a worker has sent. It returns false if the worker should be dropped,
+// either because it sent something that can't be read or because it loaded a different scene.
+static bool read_messages (Worker_link &worker, Properties *properties, int frame, vector<float> &pixels,
+                           vector<bool> &done, int &remaining) {
+  size_t used = 0;
+  while (worker.input.size() - used >= sizeof(int)) {
+    int length = get_int(&worker.input[used], 0);
+    if (length < (int)sizeof(int) || length > (int)MAX_MESSAGE_LENGTH) {
+      return false;
+    }
+    if (worker.input.size() - used - sizeof(int) < (size_t)length) {
+      break;
+    }
+    const char *body = &worker.input[used + sizeof(int)];
+    int kind = get_int(body, 0);
+
+    if (kind == MESSAGE_HELLO) {
+      if (length != 5*sizeof(int) || get_int(body, 4) != properties->imsize[0] || get_int(body, 8) != properties->imsize[1] ||
+          get_int(body, 12) != properties->frames || get_int(body, 16) != TILE_SIZE) {
+        printf("A worker loaded a different scene, so it was turned away.\n");
+        return false;
+      }
+      worker.greeted = true;
+    }
+    else if (kind == MESSAGE_PIXELS && worker.greeted) {
+      if (length < 3*(int)sizeof(int)) {
+        return false;
+      }
+      // Pixels from an earlier frame can only come from a worker that was handed tiles again, and are ignored.
+      if (get_int(body, 4) == frame) {
+        int tile = get_int(body, 8);
+        bool was_done = tile >= 0 && tile < (int)done.size() && done[tile];
+        if (!copy_tile(body, length, properties, pixels, done)) {
+          return false;
+        }
+        if (!was_done) {
+          remaining--;
+        }
+        worker.deadline = worker_deadline();
+        vector<int>::iterator t = find(worker.tiles.begin(), worker.tiles.end(), tile);
+        if (t != worker.tiles.end()) {
+          worker.tiles.erase(t);
+        }
+      }
+    }
+    else {
+      return false;
+    }
+    used += sizeof(int) + length;
+  }
+  worker.input.erase(worker.input.begin(), worker.input.begin() + used);
+  return true;
+}
+
+// The coordinator only hands out tiles and assembles what comes back, so it never builds an accelerator. Each idle
+// worker is handed a few tiles at a time, so faster workers simply ask for more. Workers may join at any time, and a
+// worker that is lost partway through a frame has its unfinished tiles handed to the others. A worker counts as lost
+// once its connection closes, or once it has gone DIST_WORKER_TIMEOUT seconds without returning a tile that it owes.
+bool gather_frame (Coordinator &coordinator, Properties *properties, int frame, vector<float> &pixels) {
+  int count = tile_count(properties);
+  vector<bool> done(count, false);
+  deque<int> pending;
+  for (int tile = 0; tile < count; tile++) {
+    pending.push_back(tile);
+  }
+  for (unsigned int w = 0; w < coordinator.workers.size(); w++) {
+    coordinator.workers[w].tiles.clear();
+  }
+
+  int remaining = count;
+  while (remaining > 0) {
+    for (int w = (int)coordinator.workers.size() - 1; w >= 0; w--) {
+      Worker_link &worker = coordinator.workers[w];
+      if (worker.greeted && worker.tiles.empty() && !pending.empty() && !hand_out(worker, pending, frame)) {
+        lose_worker(coordinator, w, pending, done);
+      }
+    }
+
+    vector<pollfd> polled(1 + coordinator.workers.size());
+    polled[0].fd = coordinator.listener;
+    polled[0].events = POLLIN;
+    for (unsigned int w = 0; w < coordinator.workers.size(); w++) {
+      polled[1 + w].fd = coordinator.workers[w].socket;
+      polled[1 + w].events = POLLIN;
+    }
+    if (poll(&polled[0], polled.size(), DIST_POLL_INTERVAL) < 0) {
+      continue;
+    }
+
+    //Workers are checked from the back, so that dropping one doesn't move the ones still to be checked.
+    for (int w = (int)coordinator.workers.size() - 1; w >= 0; w--) {
+      if (!(polled[1 + w].revents & (POLLIN | POLLHUP | POLLERR))) {
+        continue;
+      }
+      Worker_link &worker = coordinator.workers[w];
+      char buffer[DIST_READ_SIZE];
+      ssize_t received = recv(worker.socket, buffer, sizeof(buffer), 0);
+      if (received <= 0) {
+        lose_worker(coordinator, w, pending, done);
+        continue;
+      }
+      worker.input.insert(worker.input.end(), buffer, buffer + received);
+      if (!read_messages(worker, properties, frame, pixels, done, remaining)) {
+        lose_worker(coordinator, w, pending, done);
+      }
+    }
+
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    for (int w = (int)coordinator.workers.size() - 1; w >= 0; w--) {
+      Worker_link &worker = coordinator.workers[w];
+      if ((!worker.greeted || !worker.tiles.empty()) && now > worker.deadline) {
+        if (worker.greeted) {
+          printf("A worker stopped responding, so it was dropped.\n");
+        }
+        lose_worker(coordinator, w, pending, done);
+      }
+    }
+
+    if (polled[0].revents & POLLIN) {
+      int socket = accept(coordinator.listener, NULL, NULL);
+      if (socket != -1) {
+        set_up_link(socket);
+        Worker_link worker;
+        worker.socket = socket;
+        worker.greeted = false;
+        worker.deadline = worker_deadline();
+        coordinator.workers.push_back(worker);
+      }
+    }
+  }
+  return true;
+}
+
+// This function tells every worker that there is nothing left to render, and stops listening for more.
+void stop_coordinator (Coordinator &coordinator) {
+  vector<char> message;
+  finish_message(message, start_message(message, MESSAGE_DONE));
+  for (unsigned int w = 0; w < coordinator.workers.size(); w++) {
+    send_all(coordinator.workers[w].socket, message);
+    close(coordinator.workers[w].socket);
+  }
+  coordinator.workers.clear();
+  close(coordinator.listener);
+}
+
+// This function connects to a coordinator at "host:port" and describes the scene that was loaded, so that the
+// coordinator can check that it matches its own. It returns the connected socket, or -1 if no connection was made.
+int connect_worker (const char *address, Properties *properties) {
+  const char *colon = strrchr(address, ':');
+  if (colon == NULL || colon == address || colon[1] == '\0') {
+    printf("The coordinator's address \"%s\" is not recognized. Please give it as host:port.\n", address);
+    return -1;
+  }
+  vector<char> host(address, colon);
+  host.push_back('\0');
+
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *addresses;
+  if (getaddrinfo(&host[0], colon + 1, &hints, &addresses) != 0) {
+    printf("Sorry, the coordinator at \"%s\" could not be found.\n", address);
+    return -1;
+  }
+  int connected = -1;
+  for (addrinfo *a = addresses; a != NULL && connected == -1; a = a->ai_next) {
+    int socket_fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if (socket_fd == -1) {
+      continue;
+    }
+    if (connect(socket_fd, a->ai_addr, a->ai_addrlen) == 0) {
+      connected = socket_fd;
+    }
+    else {
+      close(socket_fd);
+    }
+  }
+  freeaddrinfo(addresses);
+  if (connected == -1) {
+    printf("Sorry, the coordinator at \"%s\" could not be reached.\n", address);
+    return -1;
+  }
+  set_up_link(connected);
+
+  vector<char> message;
+  size_t start = start_message(message, MESSAGE_HELLO);
+  put_int(message, properties->imsize[0]);
+  put_int(message, properties->imsize[1]);
+  put_int(message, properties->frames);
+  put_int(message, TILE_SIZE);
+  finish_message(message, start);
+  if (!send_all(connected, message)) {
+    close(connected);
+    return -1;
+  }
+  return connected;
+}
+
+// This function waits for the coordinator to hand out more tiles. It returns false once there are none left, or if
+// the coordinator was lost or sent something that can't be read. Finished is only set in the first case.
+bool next_tiles (int socket, int &frame, vector<int> &tiles, bool &finished) {
+  finished = false;
+  vector<char> body;
+  if (!receive_message(socket, body)) {
+    return false;
+  }
+  if (get_int(&body[0], 0) == MESSAGE_DONE && body.size() == sizeof(int)) {
+    finished = true;
+    return false;
+  }
+  if (get_int(&body[0], 0) != MESSAGE_TILES || body.size() < 3*sizeof(int)) {
+    return false;
+  }
+  frame = get_int(&body[0], 4);
+  int count = get_int(&body[0], 8);
+  if (count < 0 || body.size() != (3 + (size_t)count)*sizeof(int)) {
+    return false;
+  }
+  tiles.resize(count);
+  for (int i = 0; i < count; i++) {
+    tiles[i] = get_int(&body[0], (3 + i)*sizeof(int));
+  }
+  return true;
+}
+
+// This function returns the pixels of rendered tiles to the coordinator.
+bool send_tiles (int socket, Properties *properties, int frame, const vector<int> &tiles, vector<float> &pixels) {
+  vector<char> message;
+  for (vector<int>::const_iterator t = tiles.begin(); t != tiles.end(); ++t) {
+    put_tile(message, properties, frame, *t, pixels);
+  }
+  return send_all(socket, message);
+}
+
+// A partial image starts with a line that gives the image and tile size, which is followed by the same tile messages
+// that workers send. One file holds the tiles of every frame, so frames can be added as they are rendered.
+bool write_partial (const char *name, Properties *properties, int frame, const vector<int> &tiles, vector<float> &pixels) {
+  FILE *part_ptr = fopen(name, frame == 0 ? "wb" : "ab");
+  if (part_ptr == NULL) {
+    printf("Sorry, the partial image \"%s\" could not be created/opened.\n", name);
+    return false;
+  }
+  if (frame == 0) {
+    fprintf(part_ptr, "RTPART %d %d %d\n", properties->imsize[0], properties->imsize[1], TILE_SIZE);
+  }
+  vector<char> message;
+  for (vector<int>::const_iterator t = tiles.begin(); t != tiles.end(); ++t) {
+    put_tile(message, properties, frame, *t, pixels);
+  }
+  bool written = fwrite(&message[0], 1, message.size(), part_ptr) == message.size();
+  fclose(part_ptr);
+  return written;
+}
+
+// This function copies one frame's tiles from a partial image into the framebuffer, and marks them as done.
+// It returns the number of new tiles copied, or -1 if the file can't be read or belongs to a different image.
+int read_partial (const char *name, Properties *properties, int frame, vector<float> &pixels, vector<bool> &done) {
+  FILE *part_ptr = fopen(name, "rb");
+  if (part_ptr == NULL) {
+    printf("Sorry, the partial image \"%s\" could not be opened.\n", name);
+    return -1;
+  }
+  int width, height, tile_size;
+  if (fscanf(part_ptr, "RTPART %d %d %d", &width, &height, &tile_size) != 3 || fgetc(part_ptr) != '\n') {
+    printf("The file \"%s\" is not a partial image.\n", name);
+    fclose(part_ptr);
+    return -1;
+  }
+  if (width != properties->imsize[0] || height != properties->imsize[1] || tile_size != TILE_SIZE) {
+    printf("The partial image \"%s\" belongs to a different scene.\n", name);
+    fclose(part_ptr);
+    return -1;
+  }
+
+  int copied = 0;
+  int length;
+  vector<char> body;
+  while (fread(&length, sizeof(int), 1, part_ptr) == 1) {
+    if (length < 3*(int)sizeof(int) || length > (int)MAX_MESSAGE_LENGTH) {
+      copied = -1;
+      break;
+    }
+    body.resize(length);
+    if (fread(&body[0], 1, length, part_ptr) != (size_t)length || get_int(&body[0], 0) != MESSAGE_PIXELS) {
+      copied = -1;
+      break;
+    }
+    if (get_int(&body[0], 4) != frame) {
+      continue;
+    }
+    int tile = get_int(&body[0], 8);
+    bool was_done = tile >= 0 && tile < (int)done.size() && done[tile];
+    if (!copy_tile(&body[0], length, properties, pixels, done)) {
+      copied = -1;
+      break;
+    }
+    if (!was_done) {
+      copied++;
+    }
+  }
+  if (copied == -1) {
+    printf("The partial image \"%s\" is damaged.\n", name);
+  }
+  fclose(part_ptr);
+  return copied;
+}
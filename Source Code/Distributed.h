@@ -0,0 +1,73 @@
+#ifndef DISTRIBUTED_H_
+#define DISTRIBUTED_H_
+
+#include <cstdlib>
+#include <vector>
+#include <deque>
+#include <chrono>
+
+#include "Properties.h"
+#include "Render.h"
+
+using namespace std;
+
+// This resolves cyclical includes.
+struct Properties;
+
+// These macros control how the tiles of a frame are shared between processes.
+#define DIST_BATCH_TILES 8  // Workers are handed this many tiles at a time, and are handed more once they return them all.
+#define DIST_BACKLOG 16  // This many workers may be waiting to be accepted by the coordinator at once.
+#define DIST_READ_SIZE 65536  // The coordinator reads at most this many bytes from a worker at a time.
+#define DIST_WORKER_TIMEOUT 120  // A worker that returns none of its tiles for this many seconds is dropped, and its
+                                 // tiles are handed to the others. Connections that go silent are also dropped after this.
+#define DIST_POLL_INTERVAL 1000  // The coordinator checks for silent workers at least this often, in milliseconds.
+
+// These name the messages sent between the coordinator and its workers. Every message starts with its length in bytes,
+// not counting the length itself, and then its kind. Numbers are sent as they are stored, so every machine must store
+// ints and floats the same way.
+#define MESSAGE_HELLO 1  // A worker gives the image size, frame count, and tile size of the scene that it loaded.
+#define MESSAGE_TILES 2  // The coordinator hands a worker a frame number and a list of that frame's tiles to render.
+#define MESSAGE_DONE 3  // The coordinator has no more tiles to hand out, so the worker can exit.
+#define MESSAGE_PIXELS 4  // A worker returns a frame number, a tile, and the tile's pixels, row by row.
+
+// This is the coordinator's connection to one worker.
+struct Worker_link {
+  int socket;
+  bool greeted;  // This is set once the worker's scene has been checked against the coordinator's.
+  vector<char> input;  // This holds the bytes received that don't yet make up a whole message.
+  vector<int> tiles;  // These are the tiles that the worker has been handed and hasn't returned yet.
+  chrono::steady_clock::time_point deadline;  // The worker is dropped if it still owes tiles or hasn't greeted the
+                                              // coordinator by then. Each returned tile moves this back.
+};
+
+// The coordinator hands out tiles to whichever workers are idle, and assembles the frames from the pixels they return.
+struct Coordinator {
+  int listener;
+  vector<Worker_link> workers;
+  int workers_lost;
+  long tiles_reassigned;  // This counts the tiles that were handed out again after their workers were lost.
+};
+
+void put_int(vector<char> &message, int value);
+int get_int(const char *data, size_t offset);
+size_t start_message(vector<char> &message, int kind);
+void finish_message(vector<char> &message, size_t start);
+void put_tile(vector<char> &message, Properties *properties, int frame, int tile, vector<float> &pixels);
+bool copy_tile(const char *body, size_t length, Properties *properties, vector<float> &pixels, vector<bool> &done);
+bool send_all(int socket, const vector<char> &message);
+bool receive_message(int socket, vector<char> &body);
+
+bool parse_tile_list(const char *list, vector<int> &tiles);
+
+bool start_coordinator(Coordinator &coordinator, const char *port);
+bool gather_frame(Coordinator &coordinator, Properties *properties, int frame, vector<float> &pixels);
+void stop_coordinator(Coordinator &coordinator);
+
+int connect_worker(const char *address, Properties *properties);
+bool next_tiles(int socket, int &frame, vector<int> &tiles, bool &finished);
+bool send_tiles(int socket, Properties *properties, int frame, const vector<int> &tiles, vector<float> &pixels);
+
+bool write_partial(const char *name, Properties *properties, int frame, const vector<int> &tiles, vector<float> &pixels);
+int read_partial(const char *name, Properties *properties, int frame, vector<float> &pixels, vector<bool> &done);
+
+#endif
@@ -0,0 +1,283 @@
+#include <cstdlib>
+#include <cmath>
+#include <cfloat>
+#include <vector>
+#include <algorithm>
+
+#include "Accelerators.h"
+#include "Vectors.h"
+#include "Casting.h"
+#include "Objects.h"
+#include "Primitives.h"
+
+using namespace std;
+
+Grid::Grid (vector<Object*> &scene_objects) {
+  pool.assign(scene_objects);
+  build();
+}
+
+// Grids are cheap enough to build that moved objects are always handled by rebuilding.
+bool Grid::update () {
+  pool.update();
+  build();
+  return true;
+}
+
+// This function returns the number of bytes held by the cell lists and primitive pool.
+size_t Grid::memory_usage () {
+  return cell_starts.capacity()*sizeof(int) + cell_objects.capacity()*sizeof(int) + pool.memory_usage();
+}
+
+// This function sorts every object into the cells that its box overlaps.
+void Grid::build () {
+  int object_count = pool.size();
+  vector<Bounds> object_boxes(object_count);
+
+  empty_bounds(box);
+  for (int i = 0; i < object_count; i++) {
+    pool.object(i)->bounds(object_boxes[i].min, object_boxes[i].max);
+    grow_bounds(box, object_boxes[i]);
+  }
+  if (object_count == 0) {
+    for (int axis = 0; axis < 3; axis++) {
+      box.min[axis] = 0;
+      box.max[axis] = 0;
+    }
+  }
+
+  // The grid's resolution is chosen so that its cells are roughly cubes and there are about GRID_DENSITY cells per object.
+  // The box is padded slightly so that flat scenes still have a volume and objects on its faces fall inside of it.
+  float extent[3];
+  float largest = 0;
+  for (int axis = 0; axis < 3; axis++) {
+    largest = max(largest, box.max[axis] - box.min[axis]);
+  }
+  float padding = 0.001*largest + 0.0001;
+  for (int axis = 0; axis < 3; axis++) {
+    box.min[axis] -= padding;
+    box.max[axis] += padding;
+    extent[axis] = box.max[axis] - box.min[axis];
+  }
+
+  float cells_per_unit = cbrt(GRID_DENSITY*max(object_count, 1)/(extent[0]*extent[1]*extent[2]));
+  for (int axis = 0; axis < 3; axis++) {
+    resolution[axis] = (int)(extent[axis]*cells_per_unit);
+    resolution[axis] = max(1, min(resolution[axis], GRID_MAX_RESOLUTION));
+    cell_size[axis] = extent[axis]/resolution[axis];
+  }
+
+  // Each object is added to every cell that its box overlaps, first counting the references and then filling them in.
+  int cells = cell_count();
+  cell_starts.assign(cells + 1, 0);
+  vector<int> ranges(6*object_count);
+  for (int i = 0; i < object_count; i++) {
+    for (int axis = 0; axis < 3; axis++) {
+      int low = (int)((object_boxes[i].min[axis] - box.min[axis])/cell_size[axis]);
+      int high = (int)((object_boxes[i].max[axis] - box.min[axis])/cell_size[axis]);
+      ranges[6*i + axis] = max(0, min(low, resolution[axis] - 1));
+      ranges[6*i + axis + 3] = max(0, min(high, resolution[axis] - 1));
+    }
+    for (int z = ranges[6*i + 2]; z <= ranges[6*i + 5]; z++) {
+      for (int y = ranges[6*i + 1]; y <= ranges[6*i + 4]; y++) {
+        for (int x = ranges[6*i]; x <= ranges[6*i + 3]; x++) {
+          cell_starts[x + resolution[0]*(y + resolution[1]*z) + 1]++;
+        }
+      }
+    }
+  }
+  for (int c = 0; c < cells; c++) {
+    cell_starts[c + 1] += cell_starts[c];
+  }
+
+  cell_objects.resize(cell_starts[cells]);
+  vector<int> fill(cell_starts.begin(), cell_starts.end() - 1);
+  for (int i = 0; i < object_count; i++) {
+    for (int z = ranges[6*i + 2]; z <= ranges[6*i + 5]; z++) {
+      for (int y = ranges[6*i + 1]; y <= ranges[6*i + 4]; y++) {
+        for (int x = ranges[6*i]; x <= ranges[6*i + 3]; x++) {
+          cell_objects[fill[x + resolution[0]*(y + resolution[1]*z)]++] = i;
+        }
+      }
+    }
+  }
+}
+
+// This struct holds the state of a ray as it steps from cell to cell.
+struct Grid_walk {
+  int cell[3];
+  int step[3];
+  int out[3];
+  float t_next[3];
+  float t_delta[3];
+};
+
+// This function clips a ray to the grid and finds its first cell. It returns false if the ray misses the grid before tmax.
+static bool start_walk (const Ray &ray, Bounds &box, int (&resolution)[3], float (&cell_size)[3], float tmax, Grid_walk &walk) {
+  float origin[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+  float direction[3] = {ray.direction.x, ray.direction.y, ray.direction.z};
+
+  float t_enter = 0;
+  float t_exit = tmax;
+  for (int axis = 0; axis < 3; axis++) {
+    float inverse = 1/direction[axis];
+    float t1 = (box.min[axis] - origin[axis])*inverse;
+    float t2 = (box.max[axis] - origin[axis])*inverse;
+    if (t1 > t2) {
+      swap(t1, t2);
+    }
+    t_enter = t1 > t_enter ? t1 : t_enter;
+    t_exit = t2 < t_exit ? t2 : t_exit;
+  }
+  if (t_enter > t_exit) {
+    return false;
+  }
+
+  for (int axis = 0; axis < 3; axis++) {
+    float entry = origin[axis] + t_enter*direction[axis];
+    int cell = (int)floor((entry - box.min[axis])/cell_size[axis]);
+    walk.cell[axis] = max(0, min(cell, resolution[axis] - 1));
+
+    if (direction[axis] > 0) {
+      walk.step[axis] = 1;
+      walk.out[axis] = resolution[axis];
+      walk.t_next[axis] = (box.min[axis] + (walk.cell[axis] + 1)*cell_size[axis] - origin[axis])/direction[axis];
+      walk.t_delta[axis] = cell_size[axis]/direction[axis];
+    }
+    else if (direction[axis] < 0) {
+      walk.step[axis] = -1;
+      walk.out[axis] = -1;
+      walk.t_next[axis] = (box.min[axis] + walk.cell[axis]*cell_size[axis] - origin[axis])/direction[axis];
+      walk.t_delta[axis] = -cell_size[axis]/direction[axis];
+    }
+    else {
+      walk.step[axis] = 0;
+      walk.out[axis] = -1;
+      walk.t_next[axis] = FLT_MAX;
+      walk.t_delta[axis] = FLT_MAX;
+    }
+  }
+  return true;
+}
+
+// This function moves a walk into its next cell and returns the distance at which the previous cell was left.
+// Once the walk leaves the grid, -1 is returned.
+static float next_cell (Grid_walk &walk) {
+  int axis = 0;
+  if (walk.t_next[1] < walk.t_next[axis]) {
+    axis = 1;
+  }
+  if (walk.t_next[2] < walk.t_next[axis]) {
+    axis = 2;
+  }
+  float t_exit = walk.t_next[axis];
+  walk.cell[axis] += walk.step[axis];
+  if (walk.cell[axis] == walk.out[axis] || walk.step[axis] == 0) {
+    return -1;
+  }
+  walk.t_next[axis] += walk.t_delta[axis];
+  return t_exit;
+}
+
+// The closest hit found so far is kept even if it lies past the current cell,
+// so the walk only stops once it enters a cell that begins beyond that hit.
+Object *Grid::closest_intersection (const Ray &ray, float &closest_t, Intersection &hit) {
+  Object *closest_object = NULL;
+
+  Grid_walk walk;
+  if (pool.empty() || !start_walk(ray, box, resolution, cell_size, closest_t, walk)) {
+    return closest_object;
+  }
+
+  int mailbox[GRID_MAILBOX];
+  for (int i = 0; i < GRID_MAILBOX; i++) {
+    mailbox[i] = -1;
+  }
+
+  while (true) {
+    int c = walk.cell[0] + resolution[0]*(walk.cell[1] + resolution[1]*walk.cell[2]);
+    for (int i = cell_starts[c]; i < cell_starts[c + 1]; i++) {
+      int index = cell_objects[i];
+      if (mailbox[index % GRID_MAILBOX] == index) {
+        continue;
+      }
+      mailbox[index % GRID_MAILBOX] = index;
+
+      if (pool.intersect(index, ray, closest_t, hit)) {
+        closest_t = hit.distance;
+        closest_object = pool.object(index);
+      }
+    }
+
+    float t_exit = next_cell(walk);
+    if (t_exit < 0 || t_exit >= closest_t) {
+      break;
+    }
+  }
+  return closest_object;
+}
+
+// Each partially transparent object that is hit is remembered so that it only dims the light once,
+// even if the ray crosses several of the cells that it overlaps. The mailbox can forget an object when another takes
+// its slot, so every hit is kept, and hits past the first GRID_MAX_HITS are kept in a vector instead.
+float Grid::occlusion (const Ray &ray, float tmax, Object **blocker) {
+  float pass = 1;
+
+  Grid_walk walk;
+  if (pool.empty() || !start_walk(ray, box, resolution, cell_size, tmax, walk)) {
+    return pass;
+  }
+
+  int mailbox[GRID_MAILBOX];
+  for (int i = 0; i < GRID_MAILBOX; i++) {
+    mailbox[i] = -1;
+  }
+  int hits[GRID_MAX_HITS];
+  int hit_count = 0;
+  vector<int> more_hits;
+
+  while (true) {
+    int c = walk.cell[0] + resolution[0]*(walk.cell[1] + resolution[1]*walk.cell[2]);
+    for (int i = cell_starts[c]; i < cell_starts[c + 1]; i++) {
+      int index = cell_objects[i];
+      if (mailbox[index % GRID_MAILBOX] == index) {
+        continue;
+      }
+      mailbox[index % GRID_MAILBOX] = index;
+
+      bool counted = false;
+      for (int h = 0; h < hit_count; h++) {
+        if (hits[h] == index) {
+          counted = true;
+          break;
+        }
+      }
+      if (counted || find(more_hits.begin(), more_hits.end(), index) != more_hits.end()) {
+        continue;
+      }
+
+      float passed = pool.transmission(index, ray, tmax);
+      if (passed < 1) {
+        pass = pass*passed;
+        if (hit_count < GRID_MAX_HITS) {
+          hits[hit_count++] = index;
+        }
+        else {
+          more_hits.push_back(index);
+        }
+      }
+      if (pass <= 0) {
+        if (blocker != NULL) {
+          *blocker = pool.object(index);
+        }
+        return 0;
+      }
+    }
+
+    float t_exit = next_cell(walk);
+    if (t_exit < 0 || t_exit >= tmax) {
+      break;
+    }
+  }
+  return pass;
+}
@@ -0,0 +1,151 @@
+#include <cstdlib>
+#include <cmath>
+#include <cfloat>
+#include <climits>
+#include <algorithm>
+
+#include "Vectors.h"
+#include "Casting.h"
+#include "Objects.h"
+#include "Properties.h"
+#include "Accelerators.h"
+
+using namespace std;
+
+const float pi = 4.0 * atan(1.0);
+
+Instance::Instance (Mesh *mesh_ptr, float (&translation_v)[3], float (&rotation_v)[3], float (&scale_v)[3],
+                    Material *mat_ptr, Texture *tex_ptr) : Object(mat_ptr, tex_ptr), mesh(mesh_ptr) {
+  for (int i = 0; i < 3; i++) {
+    translation[i] = translation_v[i];
+    rotation[i] = rotation_v[i];
+    scale[i] = scale_v[i];
+  }
+  set_transform();
+}
+
+// The mesh is scaled first, then rotated about the x, y, and z axes in that order, and finally translated.
+void Instance::set_transform() {
+  float cx = cos(rotation[0]*pi/180);
+  float sx = sin(rotation[0]*pi/180);
+  float cy = cos(rotation[1]*pi/180);
+  float sy = sin(rotation[1]*pi/180);
+  float cz = cos(rotation[2]*pi/180);
+  float sz = sin(rotation[2]*pi/180);
+
+  float rotate[3][3] = {{cy*cz, sx*sy*cz - cx*sz, cx*sy*cz + sx*sz},
+                        {cy*sz, sx*sy*sz + cx*cz, cx*sy*sz - sx*cz},
+                        {-sy, sx*cy, cx*cy}};
+
+  // Since the rotation is orthogonal, its inverse is its transpose.
+  for (int r = 0; r < 3; r++) {
+    for (int c = 0; c < 3; c++) {
+      to_world[r][c] = rotate[r][c]*scale[c];
+      to_object[r][c] = rotate[c][r]/scale[r];
+    }
+    to_world[r][3] = translation[r];
+  }
+  for (int r = 0; r < 3; r++) {
+    to_object[r][3] = -(to_object[r][0]*translation[0] + to_object[r][1]*translation[1] + to_object[r][2]*translation[2]);
+  }
+}
+
+// Animated instances are moved and spun, so a turntable is just an instance with a spin about the y axis.
+void Instance::move(float (&velocity)[3], float (&spin)[3]) {
+  for (int i = 0; i < 3; i++) {
+    translation[i] += velocity[i];
+    rotation[i] += spin[i];
+  }
+  set_transform();
+  return;
+}
+
+// This function moves a ray from the scene into the mesh's space without normalizing it, so hit distances are the
+// same in both spaces.
+static Ray local_ray(float (&to_object)[3][4], const Ray &ray) {
+  Ray local;
+  local.origin.x = to_object[0][0]*ray.origin.x + to_object[0][1]*ray.origin.y + to_object[0][2]*ray.origin.z + to_object[0][3];
+  local.origin.y = to_object[1][0]*ray.origin.x + to_object[1][1]*ray.origin.y + to_object[1][2]*ray.origin.z + to_object[1][3];
+  local.origin.z = to_object[2][0]*ray.origin.x + to_object[2][1]*ray.origin.y + to_object[2][2]*ray.origin.z + to_object[2][3];
+  local.direction.x = to_object[0][0]*ray.direction.x + to_object[0][1]*ray.direction.y + to_object[0][2]*ray.direction.z;
+  local.direction.y = to_object[1][0]*ray.direction.x + to_object[1][1]*ray.direction.y + to_object[1][2]*ray.direction.z;
+  local.direction.z = to_object[2][0]*ray.direction.x + to_object[2][1]*ray.direction.y + to_object[2][2]*ray.direction.z;
+  return local;
+}
+
+// The closest triangle is recorded as the hit's primitive, along with its barycentric weights.
+bool Instance::ray_intersect(const Ray &ray, float tmax, Intersection &hit) {
+  float closest_t = tmax;
+  return mesh->bvh->closest_intersection(local_ray(to_object, ray), closest_t, hit) != NULL;
+}
+
+// A shadow ray is dimmed once for each face of the mesh that it crosses, just as it would be by the same triangles
+// placed in the scene without an instance. An opaque instance only needs to find one face.
+float Instance::transmission(const Ray &ray, float tmax, float opacity) {
+  if (opacity <= 0) {
+    return 1;
+  }
+  int count = mesh->bvh->crossings(local_ray(to_object, ray), tmax, opacity >= 1 ? 1 : INT_MAX);
+  float pass = 1;
+  for (int i = 0; i < count; i++) {
+    pass = pass*(1 - opacity);
+  }
+  return pass;
+}
+
+// This function moves a normal into the scene by the inverse transpose of the instance's transformation.
+static Vec3 world_normal(float (&to_object)[3][4], Vec3 normal) {
+  Vec3 world;
+  world.x = to_object[0][0]*normal.x + to_object[1][0]*normal.y + to_object[2][0]*normal.z;
+  world.y = to_object[0][1]*normal.x + to_object[1][1]*normal.y + to_object[2][1]*normal.z;
+  world.z = to_object[0][2]*normal.x + to_object[1][2]*normal.y + to_object[2][2]*normal.z;
+  return unit_vector(world);
+}
+
+// The triangle fills in the hit in the mesh's space, and its normals are then carried back into the scene.
+void Instance::complete_hit(const Ray &ray, Intersection &hit) {
+  hit.primitive->complete_hit(local_ray(to_object, ray), hit);
+  hit.point = ray.origin + ray.direction*hit.distance;
+  hit.normal = world_normal(to_object, hit.normal);
+  hit.geometric_normal = world_normal(to_object, hit.geometric_normal);
+}
+
+// Instances are textured with their own texture, using the texture coordinates of the triangle that was hit.
+void Instance::texture_color(const Intersection &hit, float (&color)[3]) {
+  float u;
+  float v;
+  if (!((Triangle*)hit.primitive)->texture_coordinates(hit, u, v)) {
+    color[0] = material->color[0];
+    color[1] = material->color[1];
+    color[2] = material->color[2];
+    return;
+  }
+
+  int i = (int)round(u*(texture->width - 1));
+  int j = (int)round(v*(texture->height - 1));
+  texel_color(texture, i, j, color);
+  return;
+}
+
+// This function returns a box around the eight transformed corners of the mesh's box.
+void Instance::bounds(float (&min)[3], float (&max)[3]) {
+  float mesh_min[3];
+  float mesh_max[3];
+  mesh->bvh->bounds(mesh_min, mesh_max);
+
+  for (int axis = 0; axis < 3; axis++) {
+    min[axis] = FLT_MAX;
+    max[axis] = -FLT_MAX;
+  }
+  for (int corner = 0; corner < 8; corner++) {
+    float x = (corner & 1) ? mesh_max[0] : mesh_min[0];
+    float y = (corner & 2) ? mesh_max[1] : mesh_min[1];
+    float z = (corner & 4) ? mesh_max[2] : mesh_min[2];
+    for (int axis = 0; axis < 3; axis++) {
+      float value = to_world[axis][0]*x + to_world[axis][1]*y + to_world[axis][2]*z + to_world[axis][3];
+      min[axis] = std::min(min[axis], value);
+      max[axis] = std::max(max[axis], value);
+    }
+  }
+  return;
+}
@@ -0,0 +1,299 @@
+#include <cstdlib>
+#include <cmath>
+#include <cfloat>
+#include <vector>
+#include <algorithm>
+
+#include "Lights.h"
+#include "Vectors.h"
+#include "Casting.h"
+
+using namespace std;
+
+const float pi = 4.0 * atan(1.0);
+
+// Every light starts out as an unattenuated point that shines in every direction.
+void Light::point_bounds (Light_bounds &bounds) {
+  bounds.min[0] = bounds.max[0] = x;
+  bounds.min[1] = bounds.max[1] = y;
+  bounds.min[2] = bounds.max[2] = z;
+  bounds.intensity = max(rgb[0], max(rgb[1], rgb[2]));
+  bounds.power = bounds.intensity;
+  bounds.attenuation[0] = 1;
+  bounds.attenuation[1] = 0;
+  bounds.attenuation[2] = 0;
+  bounds.axis[0] = 0;
+  bounds.axis[1] = 0;
+  bounds.axis[2] = 1;
+  bounds.spread = pi;
+  bounds.cone = 0;
+}
+
+// Every light's shadow rays are made first, so that they can be traced together.
+float Light::shadow (const Intersection &hit, Accelerator *accelerator, Shadow_cache &cache, const Random_key &key, unsigned int index,
+                     unsigned int sample) {
+  Ray rays[MAX_SHADOW_RAYS];
+  float distances[MAX_SHADOW_RAYS];
+  float ray_passes = 0;
+  int traced = shadow_rays(hit, key, index, sample, rays, distances, ray_passes);
+  if (traced > 0) {
+    ray_passes += cached_occlusion_sum(accelerator, rays, distances, traced, cache);
+  }
+  return ray_passes/shadow_ray_count();
+}
+
+// This function returns the angle between two unit vectors.
+static float angle_between (float (&a)[3], float (&b)[3]) {
+  float cosine = a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+  return acos(max(-1.0f, min(cosine, 1.0f)));
+}
+
+// This function finds the narrowest cone of directions around both a's and b's cones, and stores it in a.
+static void grow_cone (Light_bounds &a, Light_bounds &b) {
+  a.cone = max(a.cone, b.cone);
+  if (a.spread >= pi || b.spread >= pi) {
+    a.spread = pi;
+    return;
+  }
+
+  float difference = angle_between(a.axis, b.axis);
+  if (min(difference + b.spread, pi) <= a.spread) {
+    return;
+  }
+  if (min(difference + a.spread, pi) <= b.spread) {
+    a.axis[0] = b.axis[0];
+    a.axis[1] = b.axis[1];
+    a.axis[2] = b.axis[2];
+    a.spread = b.spread;
+    return;
+  }
+
+  // The new axis is turned from a's axis toward b's until it lies halfway between the two cones' far edges.
+  float spread = (a.spread + difference + b.spread)/2;
+  if (spread >= pi) {
+    a.spread = pi;
+    return;
+  }
+  float turn = spread - a.spread;
+  float weight_a = sin(difference - turn)/sin(difference);
+  float weight_b = sin(turn)/sin(difference);
+  float length = 0;
+  for (int i = 0; i < 3; i++) {
+    a.axis[i] = weight_a*a.axis[i] + weight_b*b.axis[i];
+    length += a.axis[i]*a.axis[i];
+  }
+  length = sqrt(length);
+  for (int i = 0; i < 3; i++) {
+    a.axis[i] /= length;
+  }
+  a.spread = spread;
+}
+
+// This function expands a group's bounds to include another light or group.
+static void grow_light_bounds (Light_bounds &a, Light_bounds &b) {
+  for (int i = 0; i < 3; i++) {
+    a.min[i] = min(a.min[i], b.min[i]);
+    a.max[i] = max(a.max[i], b.max[i]);
+  }
+  a.intensity = max(a.intensity, b.intensity);
+  a.power += b.power;
+  for (int i = 0; i < 3; i++) {
+    a.attenuation[i] = min(a.attenuation[i], b.attenuation[i]);
+  }
+  grow_cone(a, b);
+}
+
+Light_tree::Light_tree (vector<Light*> &scene_lights) : lights(scene_lights) {
+  vector<Light_node> leaves;
+  for (unsigned int i = 0; i < lights.size(); i++) {
+    Light_node leaf;
+    if (!lights[i]->bounds(leaf.bounds)) {
+      unbounded.push_back(i);
+      continue;
+    }
+    leaf.start = i;
+    leaf.count = 1;
+    leaves.push_back(leaf);
+  }
+  if (!leaves.empty()) {
+    nodes.reserve(2*leaves.size());
+    build(leaves, 0, (int)leaves.size());
+  }
+}
+
+// Each group of lights is split at the median position along its longest axis, so the tree is always balanced.
+int Light_tree::build (vector<Light_node> &leaves, int start, int end) {
+  if (end - start == 1) {
+    nodes.push_back(leaves[start]);
+    return (int)nodes.size() - 1;
+  }
+
+  int node_index = (int)nodes.size();
+  nodes.push_back(Light_node());
+  Light_bounds bounds = leaves[start].bounds;
+  for (int i = start + 1; i < end; i++) {
+    grow_light_bounds(bounds, leaves[i].bounds);
+  }
+
+  int axis = 0;
+  for (int i = 1; i < 3; i++) {
+    if (bounds.max[i] - bounds.min[i] > bounds.max[axis] - bounds.min[axis]) {
+      axis = i;
+    }
+  }
+  int middle = (start + end)/2;
+  nth_element(leaves.begin() + start, leaves.begin() + middle, leaves.begin() + end,
+              [=](const Light_node &a, const Light_node &b) {
+                return a.bounds.min[axis] < b.bounds.min[axis];
+              });
+
+  build(leaves, start, middle);
+  int right = build(leaves, middle, end);
+  nodes[node_index].bounds = bounds;
+  nodes[node_index].start = right;
+  nodes[node_index].count = 0;
+  return node_index;
+}
+
+// A group of lights is skipped when the point is outside of every spotlight's cone, or when even the brightest light
+// at the nearest point of the group's box would be attenuated below the cutoff. With a cutoff of 0, only the cone test can skip lights,
+// and since those lights add nothing to the point, the image is unchanged.
+bool Light_tree::may_light (Light_bounds &bounds, float (&point)[3], float cutoff) {
+  float nearest = 0;
+  for (int i = 0; i < 3; i++) {
+    float gap = max(bounds.min[i] - point[i], max(point[i] - bounds.max[i], 0.0f));
+    nearest += gap*gap;
+  }
+  nearest = sqrt(nearest);
+  float attenuation = bounds.attenuation[0] + bounds.attenuation[1]*nearest + bounds.attenuation[2]*nearest*nearest;
+  if (bounds.intensity < cutoff*attenuation) {
+    return false;
+  }
+
+  if (bounds.spread >= pi) {
+    return true;
+  }
+
+  // The box's bounding sphere is used to widen the cone by the spread of directions from the lights to the point.
+  float center_to_point[3];
+  float radius = 0;
+  float distance = 0;
+  for (int i = 0; i < 3; i++) {
+    float center = 0.5*(bounds.min[i] + bounds.max[i]);
+    float half = 0.5*(bounds.max[i] - bounds.min[i]);
+    center_to_point[i] = point[i] - center;
+    radius += half*half;
+    distance += center_to_point[i]*center_to_point[i];
+  }
+  radius = sqrt(radius);
+  distance = sqrt(distance);
+  if (distance <= radius) {
+    return true;
+  }
+  for (int i = 0; i < 3; i++) {
+    center_to_point[i] /= distance;
+  }
+  float angle = angle_between(bounds.axis, center_to_point);
+  float box_angle = asin(radius/distance);
+  return angle - bounds.spread - box_angle <= bounds.cone + LIGHT_CONE_MARGIN;
+}
+
+// This function lists the lights that may light a point, in the same order as the scene's lights.
+void Light_tree::gather (float (&point)[3], float cutoff, vector<int> &selected) {
+  selected.assign(unbounded.begin(), unbounded.end());
+  if (nodes.empty()) {
+    return;
+  }
+
+  int stack[LIGHT_STACK_SIZE];
+  int stack_size = 0;
+  stack[stack_size++] = 0;
+  while (stack_size > 0) {
+    int current = stack[--stack_size];
+    Light_node &node = nodes[current];
+    if (!may_light(node.bounds, point, cutoff)) {
+      continue;
+    }
+    if (node.count > 0) {
+      selected.push_back(node.start);
+    }
+    else {
+      stack[stack_size++] = node.start;
+      stack[stack_size++] = current + 1;
+    }
+  }
+
+  // The lights are summed in their original order so that culling doesn't change how the colors are rounded.
+  sort(selected.begin(), selected.end());
+}
+
+// This function estimates how much a group of lights adds to a point, using the group's total power attenuated at the
+// distance to its center, and the cosine of the smallest angle between the point and the group's cone. It is only 0
+// when the point is outside of every cone, since every other light could still be chosen.
+float Light_tree::importance (Light_bounds &bounds, float (&point)[3]) {
+  if (!may_light(bounds, point, 0)) {
+    return 0;
+  }
+
+  float center_to_point[3];
+  float radius = 0;
+  float distance = 0;
+  for (int i = 0; i < 3; i++) {
+    float center = 0.5*(bounds.min[i] + bounds.max[i]);
+    float half = 0.5*(bounds.max[i] - bounds.min[i]);
+    center_to_point[i] = point[i] - center;
+    radius += half*half;
+    distance += center_to_point[i]*center_to_point[i];
+  }
+  radius = sqrt(radius);
+  distance = sqrt(distance);
+
+  // Points inside of a group are treated as if they were at its edge, so that one close light doesn't take every sample.
+  float d = max(distance, radius);
+  float estimate = bounds.power/(bounds.attenuation[0] + bounds.attenuation[1]*d + bounds.attenuation[2]*d*d);
+
+  if (bounds.spread < pi && distance > radius) {
+    for (int i = 0; i < 3; i++) {
+      center_to_point[i] /= distance;
+    }
+    float angle = angle_between(bounds.axis, center_to_point) - bounds.spread - asin(radius/distance);
+    estimate *= max((float)cos(max(angle, 0.0f)), LIGHT_MIN_COSINE);
+  }
+  return estimate;
+}
+
+// One light is chosen by walking down the tree and picking each child in proportion to its importance, with u reused at
+// every step. The light's index and the probability of choosing it are returned, or false if no light can reach the point.
+bool Light_tree::sample (float (&point)[3], float u, int &light, float &pdf) {
+  if (nodes.empty()) {
+    return false;
+  }
+  pdf = 1;
+  int current = 0;
+  if (importance(nodes[0].bounds, point) <= 0) {
+    return false;
+  }
+  while (nodes[current].count == 0) {
+    int left = current + 1;
+    int right = nodes[current].start;
+    float left_importance = importance(nodes[left].bounds, point);
+    float right_importance = importance(nodes[right].bounds, point);
+    float total = left_importance + right_importance;
+    if (total <= 0) {
+      return false;
+    }
+    float p = left_importance/total;
+    if (u < p) {
+      u = min(u/p, 1 - FLT_EPSILON);
+      pdf *= p;
+      current = left;
+    }
+    else {
+      u = min((u - p)/(1 - p), 1 - FLT_EPSILON);
+      pdf *= 1 - p;
+      current = right;
+    }
+  }
+  light = nodes[current].start;
+  return true;
+}
@@ -1,120 +1,171 @@
-#ifndef LIGHTS_H_
-#define LIGHTS_H_
-
-#include <cstdlib>
-#include <vector>
-
-#include "Vectors.h"
-#include "Casting.h"
-#include "Properties.h"
-
-using namespace std;
-
-// These resolve cyclical includes.
-class Object;
-struct Intersection;
-
-// This is the base class for lights.
-class Light {
-  protected:
-    float x;
-    float y;
-    float z;
-
-    float rgb[3] = {1, 1, 1};
-
-  public:
-    Light (float xc = 0, float yc = 0, float zc = 0,
-           float rv = 1, float gv = 1, float bv = 1) :
-      x(xc), y(yc), z(zc) {
-      rgb[0] = rv;
-      rgb[1] = gv;
-      rgb[2] = bv;
-    }
-
-    virtual float illumination (Vector *normal, Vector *v, Intersection *intersection, float ko_d, float ko_s, float n, int rgb_index) = 0;
-    virtual float shadow(Intersection *intersection, vector<Object*> &objects, Vector *normal) = 0;
-};
-
-// This is the derived class for point and directional lights.
-class Standard_light : public Light {
-  private:
-    float w;
-
-  public:
-    Standard_light (float xc = 0, float yc = 0, float zc = 0, float wv = 0,
-                 float rv = 1, float gv = 1, float bv = 1) :
-                 Light(xc, yc, zc, rv, gv, bv), w(wv) {}
-
-    float illumination (Vector *normal, Vector *v, Intersection *intersection, float ko_d, float ko_s, float n, int rgb_index);
-    float shadow (Intersection *intersection, vector<Object*> &objects, Vector *normal);
-};
-
-
-class Att_light : public Light {
-  private:
-    float w;
-    float c1;
-    float c2;
-    float c3;
-
-  public:
-    Att_light (float xc = 0, float yc = 0, float zc = 0, float wv = 0,
-               float rv = 1, float gv = 1, float bv = 1,
-               float c1v = 1, float c2v = 1, float c3v = 1) :
-               Light(xc, yc, zc, rv, gv, bv), w(wv), c1(c1v), c2(c2v), c3(c3v) {}
-
-    float illumination (Vector *normal, Vector *v, Intersection *intersection, float ko_d, float ko_s, float n, int rgb_index);
-    float shadow(Intersection *intersection, vector<Object*> &objects, Vector *normal);
-};
-
-
-class Spotlight : public Light {
-  private:
-    Vector *direction;
-    float theta;
-
-  public:
-    Spotlight (float xc = 0, float yc = 0, float zc = 0,
-                   float xdv = 1, float ydv = 1, float zdv = 1, float angle = 45,
-                   float rv = 1, float gv = 1, float bv = 1) :
-                   Light(xc, yc, zc, rv, gv, bv), theta(angle) {
-      direction = new_vector(0, 0, 0, xdv, ydv, zdv);
-      unit_vector(direction);
-    }
-    ~Spotlight() {
-      delete direction;
-    }
-
-    float illumination (Vector *normal, Vector *v, Intersection *intersection, float ko_d, float ko_s, float n, int rgb_index);
-    float shadow(Intersection *intersection, vector<Object*> &objects, Vector *normal);
-};
-
-
-class Att_spotlight : public Light {
-  private:
-    Vector *direction;
-    float theta;
-
-    float c1;
-    float c2;
-    float c3;
-
-  public:
-    Att_spotlight (float xc = 0, float yc = 0, float zc = 0,
-               float xdv = 1, float ydv = 1, float zdv = 1, float angle = 45,
-               float rv = 1, float gv = 1, float bv = 1,
-               float c1v = 1, float c2v = 1, float c3v = 1) :
-               Light(xc, yc, zc, rv, gv, bv), theta(angle), c1(c1v), c2(c2v), c3(c3v) {
-      direction = new_vector(0, 0, 0, xdv, ydv, zdv);
-      unit_vector(direction);
-    }
-    ~Att_spotlight() {
-      delete direction;
-    }
-
-    float illumination (Vector *normal, Vector *v, Intersection *intersection, float ko_d, float ko_s, float n, int rgb_index);
-    float shadow(Intersection *intersection, vector<Object*> &objects, Vector *normal);
-};
-
-#endif
+#ifndef LIGHTS_H_
+#define LIGHTS_H_
+
+#include <cstdlib>
+#include <vector>
+
+#include "Vectors.h"
+#include "Casting.h"
+#include "Properties.h"
+
+using namespace std;
+
+// These resolve cyclical includes.
+class Object;
+class Accelerator;
+struct Intersection;
+struct Shadow_cache;
+struct Random_key;
+
+// These macros control how lights are culled at each shaded point.
+#define LIGHT_CONE_MARGIN 0.001  // Cones are widened by this many radians so that rounding never culls a lit point.
+#define LIGHT_STACK_SIZE 64
+#define LIGHT_MIN_COSINE 0.01f  // Sampled groups at the edge of their cones still get at least this much of their weight.
+
+// This describes the most that a light, or a group of lights, can contribute anywhere in the scene.
+struct Light_bounds {
+  float min[3];  // These are the corners of a box around the lights' positions.
+  float max[3];
+  float intensity;  // This is the brightest color channel.
+  float power;  // This is the sum of every light's brightest channel, which weighs groups when lights are sampled.
+  float attenuation[3];  // These are the smallest attenuation constants, which are 1, 0, and 0 for unattenuated lights.
+  float axis[3];  // Every spotlight's direction lies within spread radians of this axis.
+  float spread;  // This is pi for lights that shine in every direction.
+  float cone;  // This is the widest spotlight cone's half angle in radians.
+};
+
+// This is the base class for lights.
+class Light {
+  protected:
+    float x;
+    float y;
+    float z;
+
+    float rgb[3] = {1, 1, 1};
+
+    Vec3 position() {return Vec3{x, y, z};}
+    void point_bounds(Light_bounds &bounds);
+
+  public:
+    Light (float xc = 0, float yc = 0, float zc = 0,
+           float rv = 1, float gv = 1, float bv = 1) :
+      x(xc), y(yc), z(zc) {
+      rgb[0] = rv;
+      rgb[1] = gv;
+      rgb[2] = bv;
+    }
+
+    virtual float illumination (const Intersection &hit, Vec3 v, float ko_d, float ko_s, float n, int rgb_index) = 0;
+    // This makes the shadow rays toward the light from a hit, along with how far each may go, and returns how many
+    // were made. Rays that can't be lit, such as those outside of a spotlight's cone, are counted in ray_passes
+    // instead. Soft shadows are jittered with numbers drawn from the key of the point being shaded, the light's index in
+    // the scene, and the sample number of the light's choice, so that a light that is sampled twice casts different rays.
+    virtual int shadow_rays(const Intersection &hit, const Random_key &key, unsigned int index, unsigned int sample, Ray *rays, float *distances, float &ray_passes) = 0;
+    // This returns the fraction of the light that reaches a hit.
+    float shadow(const Intersection &hit, Accelerator *accelerator, Shadow_cache &cache, const Random_key &key, unsigned int index,
+                 unsigned int sample);
+    // This fills in the light's bounds and returns false for directional lights, which can't be bounded.
+    virtual bool bounds(Light_bounds &bounds) = 0;
+};
+
+// This is the derived class for point and directional lights.
+class Standard_light : public Light {
+  private:
+    float w;
+
+  public:
+    Standard_light (float xc = 0, float yc = 0, float zc = 0, float wv = 0,
+                 float rv = 1, float gv = 1, float bv = 1) :
+                 Light(xc, yc, zc, rv, gv, bv), w(wv) {}
+
+    float illumination (const Intersection &hit, Vec3 v, float ko_d, float ko_s, float n, int rgb_index);
+    int shadow_rays (const Intersection &hit, const Random_key &key, unsigned int index, unsigned int sample, Ray *rays, float *distances, float &ray_passes);
+    bool bounds (Light_bounds &bounds);
+};
+
+
+class Att_light : public Light {
+  private:
+    float w;
+    float c1;
+    float c2;
+    float c3;
+
+  public:
+    Att_light (float xc = 0, float yc = 0, float zc = 0, float wv = 0,
+               float rv = 1, float gv = 1, float bv = 1,
+               float c1v = 1, float c2v = 1, float c3v = 1) :
+               Light(xc, yc, zc, rv, gv, bv), w(wv), c1(c1v), c2(c2v), c3(c3v) {}
+
+    float illumination (const Intersection &hit, Vec3 v, float ko_d, float ko_s, float n, int rgb_index);
+    int shadow_rays(const Intersection &hit, const Random_key &key, unsigned int index, unsigned int sample, Ray *rays, float *distances, float &ray_passes);
+    bool bounds(Light_bounds &bounds);
+};
+
+
+class Spotlight : public Light {
+  private:
+    Vec3 direction;
+    float theta;
+
+  public:
+    Spotlight (float xc = 0, float yc = 0, float zc = 0,
+                   float xdv = 1, float ydv = 1, float zdv = 1, float angle = 45,
+                   float rv = 1, float gv = 1, float bv = 1) :
+                   Light(xc, yc, zc, rv, gv, bv), direction(unit_vector(Vec3{xdv, ydv, zdv})), theta(angle) {}
+
+    float illumination (const Intersection &hit, Vec3 v, float ko_d, float ko_s, float n, int rgb_index);
+    int shadow_rays(const Intersection &hit, const Random_key &key, unsigned int index, unsigned int sample, Ray *rays, float *distances, float &ray_passes);
+    bool bounds(Light_bounds &bounds);
+};
+
+
+class Att_spotlight : public Light {
+  private:
+    Vec3 direction;
+    float theta;
+
+    float c1;
+    float c2;
+    float c3;
+
+  public:
+    Att_spotlight (float xc = 0, float yc = 0, float zc = 0,
+               float xdv = 1, float ydv = 1, float zdv = 1, float angle = 45,
+               float rv = 1, float gv = 1, float bv = 1,
+               float c1v = 1, float c2v = 1, float c3v = 1) :
+               Light(xc, yc, zc, rv, gv, bv), direction(unit_vector(Vec3{xdv, ydv, zdv})), theta(angle), c1(c1v), c2(c2v), c3(c3v) {}
+
+    float illumination (const Intersection &hit, Vec3 v, float ko_d, float ko_s, float n, int rgb_index);
+    int shadow_rays(const Intersection &hit, const Random_key &key, unsigned int index, unsigned int sample, Ray *rays, float *distances, float &ray_passes);
+    bool bounds(Light_bounds &bounds);
+};
+
+// Nodes are stored depth-first like the object hierarchy's, so the left child of an interior node directly follows it.
+struct Light_node {
+  Light_bounds bounds;
+  int start;  // For leaves, this is the light's index. For interior nodes, it is the right child index.
+  int count;  // This is zero for interior nodes.
+};
+
+// This is a hierarchy of the scene's lights, used to skip the lights that can't noticeably light a point.
+class Light_tree {
+  private:
+    vector<Light*> &lights;
+    vector<int> unbounded;  // Directional lights are never culled.
+    vector<Light_node> nodes;
+
+    int build(vector<Light_node> &leaves, int start, int end);
+    bool may_light(Light_bounds &bounds, float (&point)[3], float cutoff);
+    float importance(Light_bounds &bounds, float (&point)[3]);
+
+  public:
+    Light_tree (vector<Light*> &scene_lights);
+
+    vector<Light*> &get_lights() {return lights;}
+    vector<int> &get_unbounded() {return unbounded;}
+    void gather(float (&point)[3], float cutoff, vector<int> &selected);
+    bool sample(float (&point)[3], float u, int &light, float &pdf);
+};
+
+#endif
@@ -1,109 +1,168 @@
-#ifndef OBJECTS_H_
-#define OBJECTS_H_
-
-#include <cstdlib>
-
-#include "Vectors.h"
-#include "Casting.h"
-#include "Properties.h"
-
-using namespace std;
-
-// These resolve cyclical inclusions.
-struct Intersection;
-struct Material;
-struct Texture;
-struct Vertex;
-struct Normal;
-struct T_coord;
-
-// This the base object class from which spheres, ellipsoids, etc. are derived from.
-class Object {
-  protected:
-    Material *material;
-    Texture *texture;
-
-  public:
-    Object (Material *mat_ptr = NULL, Texture *tex_ptr = NULL) :
-      material(mat_ptr), texture(tex_ptr) {}
-
-    Material *get_material() {return material;}
-    Texture *get_texture() {return texture;}
-
-    // Every object will have its own implementation for testing intersections.
-    virtual Intersection *ray_intersect(Vector *ray) = 0;
-    // The way normal vectors are calculated is unique to each object type.
-    virtual Vector *find_normal(Intersection *intersection) = 0;
-    // Texture retrieval is based on normal vectors.
-    virtual void texture_color(Intersection *intersection, float (&color)[3]) = 0;
-};
-
-// This is the derived class for spheres.
-class Sphere : public Object {
-  private:
-    float x;
-    float y;
-    float z;
-
-    float radius;
-
-  public:
-    Sphere (float xc = 0, float yc = 0, float zc = 0, float r = 1,
-            Material *mat_ptr = NULL, Texture *tex_ptr = NULL) :
-            Object(mat_ptr, tex_ptr), x(xc), y(yc), z(zc), radius(r) {}
-
-    Intersection *ray_intersect(Vector *ray);
-    Vector *find_normal(Intersection *point);
-    void texture_color(Intersection *intersection, float (&color)[3]);
-};
-
-// This is the derived class for ellipsoids.
-class Ellipsoid : public Object {
-  private:
-    float x;
-    float y;
-    float z;
-
-    float x_radius;
-    float y_radius;
-    float z_radius;
-
-  public:
-    Ellipsoid (float xc = 0, float yc = 0, float zc = 0,
-               float xr = 1, float yr = 1, float zr = 1,
-               Material *mat_ptr = NULL, Texture *tex_ptr = NULL) :
-               Object(mat_ptr, tex_ptr), x(xc), y(yc), z(zc), x_radius(xr), y_radius(yr), z_radius(zr) {}
-
-    Intersection *ray_intersect(Vector *ray);
-    Vector *find_normal(Intersection *intersection);
-    void texture_color(Intersection *intersection, float (&color)[3]);
-};
-
-// This is the derived class for triangles.
-class Triangle : public Object {
-  private:
-    Vertex *v1;
-    Vertex *v2;
-    Vertex *v3;
-
-    Normal *n1;
-    Normal *n2;
-    Normal *n3;
-
-    T_coord *t1;
-    T_coord *t2;
-    T_coord *t3;
-
-  public:
-    Triangle (Vertex *vertex1 = NULL, Vertex *vertex2 = NULL, Vertex *vertex3 = NULL,
-              Normal *normal1 = NULL, Normal *normal2 = NULL, Normal *normal3 = NULL,
-              T_coord *t1v = NULL, T_coord *t2v = NULL, T_coord *t3v = NULL,
-              Material *mat_ptr = NULL, Texture *tex_ptr = NULL) :
-               Object(mat_ptr, tex_ptr), v1(vertex1), v2(vertex2), v3(vertex3), n1(normal1), n2(normal2), n3(normal3), t1(t1v), t2(t2v), t3(t3v) {}
-
-    Intersection *ray_intersect(Vector *ray);
-    Vector *find_normal(Intersection *intersection);
-    void texture_color(Intersection *intersection, float (&color)[3]);
-};
-
-#endif
+#ifndef OBJECTS_H_
+#define OBJECTS_H_
+
+#include <cstdlib>
+#include <cstdint>
+
+#include "Vectors.h"
+#include "Casting.h"
+#include "Properties.h"
+
+using namespace std;
+
+// These resolve cyclical inclusions.
+struct Intersection;
+struct Material;
+struct Texture;
+struct Triangle_store;
+struct Mesh;
+
+// These identify the kinds of objects that primitive pools can test without a virtual call.
+#define OBJECT_OTHER 0
+#define OBJECT_SPHERE 1
+#define OBJECT_ELLIPSOID 2
+#define OBJECT_TRIANGLE 3
+
+// This marks a triangle corner that has no vertex normal or texture coordinate.
+#define NO_INDEX 0xFFFFFFFFu
+
+// This the base object class from which spheres, ellipsoids, etc. are derived from.
+class Object {
+  protected:
+    Material *material;
+    Texture *texture;
+
+  public:
+    Object (Material *mat_ptr = NULL, Texture *tex_ptr = NULL) :
+      material(mat_ptr), texture(tex_ptr) {}
+    virtual ~Object () {}
+
+    Material *get_material() {return material;}
+    Texture *get_texture() {return texture;}
+    virtual int type() {return OBJECT_OTHER;}
+
+    // Every object will have its own implementation for testing intersections. A hit is only recorded, and true only
+    // returned, when the ray hits the object between 0 and tmax.
+    virtual bool ray_intersect(const Ray &ray, float tmax, Intersection &hit) = 0;
+    // The way normal vectors are calculated is unique to each object type. This fills in the rest of a recorded hit.
+    virtual void complete_hit(const Ray &ray, Intersection &hit) = 0;
+    // Texture retrieval is based on normal vectors.
+    virtual void texture_color(const Intersection &hit, float (&color)[3]) = 0;
+    // Each object reports an axis-aligned box that encloses it for the bounding volume hierarchy.
+    virtual void bounds(float (&min)[3], float (&max)[3]) = 0;
+    // Animated objects are moved and spun by the same amount every frame. Triangles move with their vertices instead.
+    virtual void move(float (&velocity)[3], float (&spin)[3]) {}
+    // A shadow ray is dimmed once by each object that it crosses before tmax, and this returns the fraction of its light
+    // that passes. Objects made of many faces, such as instances, dim it once for each face that it crosses instead.
+    virtual float transmission(const Ray &ray, float tmax, float opacity);
+};
+
+// This is the derived class for spheres.
+class Sphere : public Object {
+  friend class Primitive_pool;
+
+  private:
+    float x;
+    float y;
+    float z;
+
+    float radius;
+
+  public:
+    Sphere (float xc = 0, float yc = 0, float zc = 0, float r = 1,
+            Material *mat_ptr = NULL, Texture *tex_ptr = NULL) :
+            Object(mat_ptr, tex_ptr), x(xc), y(yc), z(zc), radius(r) {}
+
+    int type() {return OBJECT_SPHERE;}
+    bool ray_intersect(const Ray &ray, float tmax, Intersection &hit);
+    void complete_hit(const Ray &ray, Intersection &hit);
+    void texture_color(const Intersection &hit, float (&color)[3]);
+    void bounds(float (&min)[3], float (&max)[3]);
+    void move(float (&velocity)[3], float (&spin)[3]);
+};
+
+// This is the derived class for ellipsoids.
+class Ellipsoid : public Object {
+  friend class Primitive_pool;
+
+  private:
+    float x;
+    float y;
+    float z;
+
+    float x_radius;
+    float y_radius;
+    float z_radius;
+
+  public:
+    Ellipsoid (float xc = 0, float yc = 0, float zc = 0,
+               float xr = 1, float yr = 1, float zr = 1,
+               Material *mat_ptr = NULL, Texture *tex_ptr = NULL) :
+               Object(mat_ptr, tex_ptr), x(xc), y(yc), z(zc), x_radius(xr), y_radius(yr), z_radius(zr) {}
+
+    int type() {return OBJECT_ELLIPSOID;}
+    bool ray_intersect(const Ray &ray, float tmax, Intersection &hit);
+    void complete_hit(const Ray &ray, Intersection &hit);
+    void texture_color(const Intersection &hit, float (&color)[3]);
+    void bounds(float (&min)[3], float (&max)[3]);
+    void move(float (&velocity)[3], float (&spin)[3]);
+};
+
+// This is the derived class for triangles. Each corner is a 32-bit index into the scene's triangle store.
+class Triangle : public Object {
+  friend class Primitive_pool;
+
+  private:
+    Triangle_store *store;
+    uint32_t vertices[3];
+    uint32_t normals[3];
+    uint32_t t_coords[3];
+
+    // The first vertex, the two edges leaving it, and the unit plane normal are found when the triangle is made,
+    // and again whenever its vertices move, so that hit tests only read them.
+    Vec3 corner;
+    Vec3 edge1;
+    Vec3 edge2;
+    Vec3 plane_normal;
+
+  public:
+    Triangle (Triangle_store *store_ptr, uint32_t (&vertex_v)[3], uint32_t (&normal_v)[3], uint32_t (&t_coord_v)[3],
+              Material *mat_ptr = NULL, Texture *tex_ptr = NULL);
+
+    int type() {return OBJECT_TRIANGLE;}
+    bool ray_intersect(const Ray &ray, float tmax, Intersection &hit);
+    void complete_hit(const Ray &ray, Intersection &hit);
+    void texture_color(const Intersection &hit, float (&color)[3]);
+    void bounds(float (&min)[3], float (&max)[3]);
+    bool texture_coordinates(const Intersection &hit, float &u, float &v);
+    void refresh();
+};
+
+// This is the derived class for transformed copies of a mesh. Every instance shares its mesh's triangles and hierarchy.
+class Instance : public Object {
+  private:
+    Mesh *mesh;
+
+    float translation[3];
+    float rotation[3];
+    float scale[3];
+
+    // These 3x4 matrices map points between the mesh's space and the scene.
+    float to_world[3][4];
+    float to_object[3][4];
+
+    void set_transform();
+
+  public:
+    Instance (Mesh *mesh_ptr, float (&translation_v)[3], float (&rotation_v)[3], float (&scale_v)[3],
+              Material *mat_ptr = NULL, Texture *tex_ptr = NULL);
+
+    bool ray_intersect(const Ray &ray, float tmax, Intersection &hit);
+    void complete_hit(const Ray &ray, Intersection &hit);
+    void texture_color(const Intersection &hit, float (&color)[3]);
+    void bounds(float (&min)[3], float (&max)[3]);
+    void move(float (&velocity)[3], float (&spin)[3]);
+    float transmission(const Ray &ray, float tmax, float opacity);
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include <cstdlib>
+#include <vector>
+#include <cstring>
+#include <unordered_map>
+#include <algorithm>
+
+#include "Primitives.h"
+#include "Vectors.h"
+#include "Objects.h"
+#include "Properties.h"
+
+using namespace std;
+
+// This function fills the pool with a list of objects, keeping their order. Each object's material is given an index into
+// the pool's own table, so that shadow rays can read opacities without following each object's material pointer.
+void Primitive_pool::assign (vector<Object*> &pool_objects) {
+  objects = pool_objects;
+  types.assign(objects.size(), OBJECT_OTHER);
+  slots.assign(objects.size(), -1);
+  materials.assign(objects.size(), 0);
+  material_table.clear();
+  opacities.clear();
+  blocks.clear();
+  object_blocks.clear();
+  unordered_map<Material*, int> material_indices;
+
+  int sphere_count = 0;
+  int ellipsoid_count = 0;
+  int triangle_count = 0;
+  for (unsigned int i = 0; i < objects.size(); i++) {
+    types[i] = objects[i]->type();
+    if (types[i] == OBJECT_SPHERE) {
+      slots[i] = sphere_count++;
+    }
+    else if (types[i] == OBJECT_ELLIPSOID) {
+      slots[i] = ellipsoid_count++;
+    }
+    else if (types[i] == OBJECT_TRIANGLE) {
+      slots[i] = triangle_count++;
+    }
+
+    Material *material = objects[i]->get_material();
+    unordered_map<Material*, int>::iterator found = material_indices.find(material);
+    if (found == material_indices.end()) {
+      found = material_indices.insert(make_pair(material, (int)material_table.size())).first;
+      material_table.push_back(material);
+      opacities.push_back(material->opacity);
+    }
+    materials[i] = found->second;
+  }
+
+  sphere_centers.resize(sphere_count);
+  sphere_radii.resize(sphere_count);
+  ellipsoid_centers.resize(ellipsoid_count);
+  ellipsoid_radii.resize(ellipsoid_count);
+  triangle_corners.resize(triangle_count);
+  triangle_edges1.resize(triangle_count);
+  triangle_edges2.resize(triangle_count);
+  copy_shapes();
+}
+
+// This function copies every shape's current position into the pool, and then into its blocks. It is called again after
+// objects move.
+void Primitive_pool::update () {
+  copy_shapes();
+  fill_blocks();
+}
+
+// This function copies every shape's current position into the arrays for its type.
+void Primitive_pool::copy_shapes () {
+  for (unsigned int i = 0; i < objects.size(); i++) {
+    int slot = slots[i];
+    if (types[i] == OBJECT_SPHERE) {
+      Sphere *sphere = (Sphere*)objects[i];
+      sphere_centers[slot] = Vec3{sphere->x, sphere->y, sphere->z};
+      sphere_radii[slot] = sphere->radius;
+    }
+    else if (types[i] == OBJECT_ELLIPSOID) {
+      Ellipsoid *ellipsoid = (Ellipsoid*)objects[i];
+      ellipsoid_centers[slot] = Vec3{ellipsoid->x, ellipsoid->y, ellipsoid->z};
+      ellipsoid_radii[slot] = Vec3{ellipsoid->x_radius, ellipsoid->y_radius, ellipsoid->z_radius};
+    }
+    else if (types[i] == OBJECT_TRIANGLE) {
+      Triangle *triangle = (Triangle*)objects[i];
+      triangle_corners[slot] = triangle->corner;
+      triangle_edges1[slot] = triangle->edge1;
+      triangle_edges2[slot] = triangle->edge2;
+    }
+  }
+}
+
+// This function groups each leaf's objects into blocks. A block ends at the end of a leaf, when the next object's
+// type differs, or once it is full. Objects that aren't spheres, ellipsoids, or triangles are each put in a block alone.
+void Primitive_pool::make_blocks (vector<int> &leaf_starts) {
+  sort(leaf_starts.begin(), leaf_starts.end());
+  blocks.clear();
+  object_blocks.assign(objects.size() + 1, 0);
+  unsigned int next_leaf = 0;
+  for (int i = 0; i < size(); i++) {
+    bool leaf_start = next_leaf < leaf_starts.size() && leaf_starts[next_leaf] == i;
+    if (leaf_start) {
+      next_leaf++;
+    }
+    if (!leaf_start && !blocks.empty() && blocks.back().type == types[i] && types[i] != OBJECT_OTHER &&
+        blocks.back().count < LEAF_BLOCK_SIZE) {
+      blocks.back().count++;
+    }
+    else {
+      Primitive_block block;
+      block.first = i;
+      block.type = types[i];
+      block.count = 1;
+      blocks.push_back(block);
+    }
+    object_blocks[i] = (int)blocks.size() - 1;
+  }
+  object_blocks[objects.size()] = (int)blocks.size();
+  fill_blocks();
+}
+
+// This function copies each block's shapes from the pool's arrays.
+void Primitive_pool::fill_blocks () {
+  for (unsigned int b = 0; b < blocks.size(); b++) {
+    Primitive_block &block = blocks[b];
+    memset(block.rows, 0, sizeof(block.rows));
+    for (int lane = 0; lane < LEAF_BLOCK_SIZE; lane++) {
+      int i = block.first + (lane < block.count ? lane : 0);
+      int slot = slots[i];
+      Vec3 fields[3];
+      int field_count = 0;
+      if (block.type == OBJECT_SPHERE) {
+        fields[0] = sphere_centers[slot];
+        fields[1] = Vec3{sphere_radii[slot], 0, 0};
+        field_count = 2;
+      }
+      else if (block.type == OBJECT_ELLIPSOID) {
+        fields[0] = ellipsoid_centers[slot];
+        fields[1] = ellipsoid_radii[slot];
+        field_count = 2;
+      }
+      else if (block.type == OBJECT_TRIANGLE) {
+        fields[0] = triangle_corners[slot];
+        fields[1] = triangle_edges1[slot];
+        fields[2] = triangle_edges2[slot];
+        field_count = 3;
+      }
+      for (int field = 0; field < field_count; field++) {
+        block.rows[3*field][lane] = fields[field].x;
+        block.rows[3*field + 1][lane] = fields[field].y;
+        block.rows[3*field + 2][lane] = fields[field].z;
+      }
+    }
+  }
+}
+
+// This function returns the number of bytes held by the pool.
+size_t Primitive_pool::memory_usage () {
+  return objects.capacity()*sizeof(Object*) + types.capacity()*sizeof(unsigned char) +
+         slots.capacity()*sizeof(int) + materials.capacity()*sizeof(int) +
+         opacities.capacity()*sizeof(float) + material_table.capacity()*sizeof(Material*) +
+         sphere_centers.capacity()*sizeof(Vec3) + sphere_radii.capacity()*sizeof(float) +
+         ellipsoid_centers.capacity()*sizeof(Vec3) + ellipsoid_radii.capacity()*sizeof(Vec3) +
+         (triangle_corners.capacity() + triangle_edges1.capacity() + triangle_edges2.capacity())*sizeof(Vec3) +
+         blocks.capacity()*sizeof(Primitive_block) + object_blocks.capacity()*sizeof(int);
+}
@@ -0,0 +1,568 @@
+#ifndef PRIMITIVES_H_
+#define PRIMITIVES_H_
+
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Vectors.h"
+#include "Casting.h"
+#include "Objects.h"
+#include "Accelerators.h"
+
+using namespace std;
+
+// These functions hold the intersection math for each shape. The objects' own ray_intersect functions and the
+// primitive pools both call them, so a shape is hit at exactly the same distance either way.
+
+// This function finds where a ray first hits a sphere. It returns false unless that distance is between 0 and tmax.
+inline bool sphere_hit (const Ray &ray, Vec3 center, float radius, float tmax, float &distance) {
+  distance = 0;
+  float b = 2*(ray.direction.x*(ray.origin.x - center.x) + ray.direction.y*(ray.origin.y - center.y) + ray.direction.z*(ray.origin.z - center.z));
+  float c = pow(ray.origin.x - center.x, 2) + pow(ray.origin.y - center.y, 2) + pow(ray.origin.z - center.z, 2) - pow(radius, 2);
+  float discriminant = pow(b, 2)-4*c;
+
+  if (discriminant == 0) {
+    distance = -b/2;
+  }
+  else if (discriminant > 0) {
+    float solution1 = (-b+sqrt(discriminant))/2;
+    float solution2 = (-b-sqrt(discriminant))/2;
+    if (solution1 <= solution2 && solution1 > 0) {
+      distance = solution1;
+    }
+    else if (solution1 > 0 && solution2 <= 0) {
+      distance = solution1;
+    }
+    else {
+      distance = solution2;
+    }
+  }
+  return distance > 0 && distance < tmax;
+}
+
+// This function finds where a ray first hits an ellipsoid. It returns false unless that distance is between 0 and tmax.
+inline bool ellipsoid_hit (const Ray &ray, Vec3 center, Vec3 radii, float tmax, float &distance) {
+  float x = center.x;
+  float y = center.y;
+  float z = center.z;
+  distance = 0;
+  float a = pow(ray.direction.x/radii.x, 2) + pow(ray.direction.y/radii.y, 2) + pow(ray.direction.z/radii.z, 2);
+  float b = (2*ray.direction.x*(ray.origin.x - x))/pow(radii.x, 2) + (2*ray.direction.y*(ray.origin.y - y))/pow(radii.y, 2) + (2*ray.direction.z*(ray.origin.z - z))/pow(radii.z, 2);
+  float c = (pow(x, 2) - 2*x*ray.origin.x + pow(ray.origin.x, 2))/pow(radii.x, 2) + (pow(y, 2) - 2*y*ray.origin.y + pow(ray.origin.y, 2))/pow(radii.y, 2) + (pow(z, 2) - 2*z*ray.origin.z + pow(ray.origin.z, 2))/pow(radii.z, 2) - 1;
+  float discriminant = pow(b, 2)-4*a*c;
+  if (discriminant == 0) {
+    distance = -b/(2*a);
+  }
+  else if (discriminant > 0) {
+    float solution1 = (-b+sqrt(discriminant))/(2*a);
+    float solution2 = (-b-sqrt(discriminant))/(2*a);
+    if (solution1 <= solution2 && solution1 > 0) {
+      distance = solution1;
+    }
+    else if (solution1 > 0 && solution2 <= 0) {
+      distance = solution1;
+    }
+    else {
+      distance = solution2;
+    }
+  }
+  return distance > 0 && distance < tmax;
+}
+
+// This is the Moller-Trumbore test, which solves for the distance and two of the barycentric weights at once with
+// Cramer's rule. Each weight is checked as soon as it is known, so most misses return before the distance is found.
+inline bool triangle_hit (const Ray &ray, Vec3 corner, Vec3 edge1, Vec3 edge2, float tmax, float &distance, float &beta, float &gamma) {
+  Vec3 p = cross_product(ray.direction, edge2);
+  float determinant = dot_product(edge1, p);
+
+  // Rays that run parallel to the triangle's plane never hit it.
+  if (determinant == 0) {
+    return false;
+  }
+  float inverse = 1/determinant;
+
+  Vec3 s = ray.origin - corner;
+  beta = dot_product(s, p)*inverse;
+  if (beta < 0 || beta > 1) {
+    return false;
+  }
+
+  Vec3 q = cross_product(s, edge1);
+  gamma = dot_product(ray.direction, q)*inverse;
+  if (gamma < 0 || beta + gamma > 1) {
+    return false;
+  }
+
+  distance = dot_product(edge2, q)*inverse;
+  return distance > 0 && distance < tmax;
+}
+
+// The versions below test four rays against four shapes at once, one of each per SSE lane. Packets repeat one shape in
+// every lane, and leaf blocks repeat one ray. Each step rounds exactly as the single-ray version does, including the
+// steps that those take in double precision, so every version gives identical hits. Each returns a bit mask of the
+// lanes that hit their shape before their own tmax, and fills in those lanes' distances.
+#ifdef __SSE2__
+// This holds four doubles in two SSE registers, for the parts of the quadratic tests that are found in double precision.
+struct Double4 {
+  __m128d low;
+  __m128d high;
+};
+
+inline Double4 widen (__m128 a) {
+  return Double4{_mm_cvtps_pd(a), _mm_cvtps_pd(_mm_movehl_ps(a, a))};
+}
+
+inline __m128 narrow (Double4 a) {
+  return _mm_movelh_ps(_mm_cvtpd_ps(a.low), _mm_cvtpd_ps(a.high));
+}
+
+inline Double4 operator+ (Double4 a, Double4 b) {
+  return Double4{_mm_add_pd(a.low, b.low), _mm_add_pd(a.high, b.high)};
+}
+
+inline Double4 operator- (Double4 a, Double4 b) {
+  return Double4{_mm_sub_pd(a.low, b.low), _mm_sub_pd(a.high, b.high)};
+}
+
+inline Double4 operator* (Double4 a, Double4 b) {
+  return Double4{_mm_mul_pd(a.low, b.low), _mm_mul_pd(a.high, b.high)};
+}
+
+inline Double4 operator/ (Double4 a, Double4 b) {
+  return Double4{_mm_div_pd(a.low, b.low), _mm_div_pd(a.high, b.high)};
+}
+
+// This function picks the nearer positive root of each quadratic in the same way as the single-ray tests. Lanes whose
+// discriminant is negative keep a distance of 0, which is then rejected.
+inline int lane_roots (__m128 b, __m128 discriminant, __m128 denominator, __m128 tmax, __m128 &distance) {
+  __m128 zero = _mm_setzero_ps();
+  __m128 root = _mm_sqrt_ps(discriminant);
+  __m128 negative_b = _mm_sub_ps(zero, b);
+  __m128 solution1 = _mm_div_ps(_mm_add_ps(negative_b, root), denominator);
+  __m128 solution2 = _mm_div_ps(_mm_sub_ps(negative_b, root), denominator);
+  __m128 first_positive = _mm_cmpgt_ps(solution1, zero);
+  __m128 pick_first = _mm_and_ps(first_positive, _mm_or_ps(_mm_cmple_ps(solution1, solution2), _mm_cmple_ps(solution2, zero)));
+  __m128 chosen = _mm_or_ps(_mm_and_ps(pick_first, solution1), _mm_andnot_ps(pick_first, solution2));
+
+  __m128 touching = _mm_cmpeq_ps(discriminant, zero);
+  chosen = _mm_or_ps(_mm_and_ps(touching, _mm_div_ps(negative_b, denominator)), _mm_andnot_ps(touching, chosen));
+  distance = _mm_and_ps(_mm_cmpge_ps(discriminant, zero), chosen);
+  return _mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(distance, zero), _mm_cmplt_ps(distance, tmax)));
+}
+
+inline int sphere_lanes (__m128 (&origin)[3], __m128 (&direction)[3], __m128 (&center)[3], __m128 radius, __m128 tmax,
+                         __m128 &distance) {
+  __m128 ex = _mm_sub_ps(origin[0], center[0]);
+  __m128 ey = _mm_sub_ps(origin[1], center[1]);
+  __m128 ez = _mm_sub_ps(origin[2], center[2]);
+  __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(direction[0], ex), _mm_mul_ps(direction[1], ey)), _mm_mul_ps(direction[2], ez));
+  __m128 b = _mm_mul_ps(_mm_set1_ps(2), dot);
+
+  Double4 wide_x = widen(ex);
+  Double4 wide_y = widen(ey);
+  Double4 wide_z = widen(ez);
+  Double4 wide_radius = widen(radius);
+  __m128 c = narrow(wide_x*wide_x + wide_y*wide_y + wide_z*wide_z - wide_radius*wide_radius);
+
+  Double4 wide_b = widen(b);
+  __m128 discriminant = narrow(wide_b*wide_b - widen(_mm_mul_ps(_mm_set1_ps(4), c)));
+  return lane_roots(b, discriminant, _mm_set1_ps(2), tmax, distance);
+}
+
+inline int ellipsoid_lanes (__m128 (&origin)[3], __m128 (&direction)[3], __m128 (&center)[3], __m128 (&radii)[3], __m128 tmax,
+                            __m128 &distance) {
+  Double4 a_sum;
+  Double4 b_sum;
+  Double4 c_sum;
+  for (int axis = 0; axis < 3; axis++) {
+    Double4 wide_radius = widen(radii[axis]);
+    Double4 radius_squared = wide_radius*wide_radius;
+
+    Double4 scaled = widen(_mm_div_ps(direction[axis], radii[axis]));
+    Double4 a_term = scaled*scaled;
+    __m128 b_numerator = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(2), direction[axis]), _mm_sub_ps(origin[axis], center[axis]));
+    Double4 b_term = widen(b_numerator)/radius_squared;
+    Double4 wide_center = widen(center[axis]);
+    Double4 wide_origin = widen(origin[axis]);
+    __m128 cross_term = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(2), center[axis]), origin[axis]);
+    Double4 c_term = (wide_center*wide_center - widen(cross_term) + wide_origin*wide_origin)/radius_squared;
+
+    a_sum = axis == 0 ? a_term : a_sum + a_term;
+    b_sum = axis == 0 ? b_term : b_sum + b_term;
+    c_sum = axis == 0 ? c_term : c_sum + c_term;
+  }
+  __m128 a = narrow(a_sum);
+  __m128 b = narrow(b_sum);
+  __m128 c = narrow(c_sum - widen(_mm_set1_ps(1)));
+
+  Double4 wide_b = widen(b);
+  __m128 discriminant = narrow(wide_b*wide_b - widen(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(4), a), c)));
+  return lane_roots(b, discriminant, _mm_mul_ps(_mm_set1_ps(2), a), tmax, distance);
+}
+
+// The weights are rejected with negated comparisons, so that NaNs pass them just as they pass the single-ray test.
+inline int triangle_lanes (__m128 (&origin)[3], __m128 (&direction)[3], __m128 (&corner)[3], __m128 (&edge1)[3],
+                           __m128 (&edge2)[3], __m128 tmax, __m128 &distance, __m128 &beta, __m128 &gamma) {
+  __m128 px = _mm_sub_ps(_mm_mul_ps(direction[1], edge2[2]), _mm_mul_ps(direction[2], edge2[1]));
+  __m128 py = _mm_sub_ps(_mm_mul_ps(direction[2], edge2[0]), _mm_mul_ps(direction[0], edge2[2]));
+  __m128 pz = _mm_sub_ps(_mm_mul_ps(direction[0], edge2[1]), _mm_mul_ps(direction[1], edge2[0]));
+  __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(edge1[0], px), _mm_mul_ps(edge1[1], py)), _mm_mul_ps(edge1[2], pz));
+  __m128 zero = _mm_setzero_ps();
+  __m128 one = _mm_set1_ps(1);
+  __m128 inverse = _mm_div_ps(one, determinant);
+
+  __m128 sx = _mm_sub_ps(origin[0], corner[0]);
+  __m128 sy = _mm_sub_ps(origin[1], corner[1]);
+  __m128 sz = _mm_sub_ps(origin[2], corner[2]);
+  beta = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverse);
+
+  __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, edge1[2]), _mm_mul_ps(sz, edge1[1]));
+  __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, edge1[0]), _mm_mul_ps(sx, edge1[2]));
+  __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, edge1[1]), _mm_mul_ps(sy, edge1[0]));
+  gamma = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(direction[0], qx), _mm_mul_ps(direction[1], qy)), _mm_mul_ps(direction[2], qz)), inverse);
+  distance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edge2[0], qx), _mm_mul_ps(edge2[1], qy)), _mm_mul_ps(edge2[2], qz)), inverse);
+
+  __m128 valid = _mm_cmpneq_ps(determinant, zero);
+  valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpnlt_ps(beta, zero), _mm_cmpngt_ps(beta, one)));
+  valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpnlt_ps(gamma, zero), _mm_cmpngt_ps(_mm_add_ps(beta, gamma), one)));
+  valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(distance, zero), _mm_cmplt_ps(distance, tmax)));
+  return _mm_movemask_ps(valid);
+}
+
+// These load a packet's rays into lanes, and repeat one vector in every lane.
+inline void load_lanes (const float (&rows)[3][PACKET_SIZE], __m128 (&lanes)[3]) {
+  for (int axis = 0; axis < 3; axis++) {
+    lanes[axis] = _mm_load_ps(rows[axis]);
+  }
+}
+
+inline void repeat_lanes (Vec3 a, __m128 (&lanes)[3]) {
+  lanes[0] = _mm_set1_ps(a.x);
+  lanes[1] = _mm_set1_ps(a.y);
+  lanes[2] = _mm_set1_ps(a.z);
+}
+
+inline int sphere_hit_packet (const Ray_packet &packet, int mask, Vec3 center, float radius,
+                              const float (&tmax)[PACKET_SIZE], float (&distance)[PACKET_SIZE]) {
+  __m128 origin[3], direction[3], centers[3], t;
+  load_lanes(packet.origin, origin);
+  load_lanes(packet.direction, direction);
+  repeat_lanes(center, centers);
+  int hits = sphere_lanes(origin, direction, centers, _mm_set1_ps(radius), _mm_load_ps(tmax), t);
+  _mm_storeu_ps(distance, t);
+  return hits & mask;
+}
+
+inline int ellipsoid_hit_packet (const Ray_packet &packet, int mask, Vec3 center, Vec3 radii,
+                                 const float (&tmax)[PACKET_SIZE], float (&distance)[PACKET_SIZE]) {
+  __m128 origin[3], direction[3], centers[3], radius[3], t;
+  load_lanes(packet.origin, origin);
+  load_lanes(packet.direction, direction);
+  repeat_lanes(center, centers);
+  repeat_lanes(radii, radius);
+  int hits = ellipsoid_lanes(origin, direction, centers, radius, _mm_load_ps(tmax), t);
+  _mm_storeu_ps(distance, t);
+  return hits & mask;
+}
+
+inline int triangle_hit_packet (const Ray_packet &packet, int mask, Vec3 corner, Vec3 edge1, Vec3 edge2,
+                                const float (&tmax)[PACKET_SIZE], float (&distance)[PACKET_SIZE],
+                                float (&beta)[PACKET_SIZE], float (&gamma)[PACKET_SIZE]) {
+  __m128 origin[3], direction[3], corners[3], edges1[3], edges2[3], t, b, g;
+  load_lanes(packet.origin, origin);
+  load_lanes(packet.direction, direction);
+  repeat_lanes(corner, corners);
+  repeat_lanes(edge1, edges1);
+  repeat_lanes(edge2, edges2);
+  int hits = triangle_lanes(origin, direction, corners, edges1, edges2, _mm_load_ps(tmax), t, b, g);
+  _mm_storeu_ps(distance, t);
+  _mm_storeu_ps(beta, b);
+  _mm_storeu_ps(gamma, g);
+  return hits & mask;
+}
+
+// This function tests one ray against every shape of a leaf block at once. Triangles also fill in their weights.
+inline int block_hits (const Primitive_block &block, const Ray &ray, float tmax, float (&distance)[LEAF_BLOCK_SIZE],
+                       float (&beta)[LEAF_BLOCK_SIZE], float (&gamma)[LEAF_BLOCK_SIZE]) {
+  __m128 origin[3], direction[3], t;
+  repeat_lanes(ray.origin, origin);
+  repeat_lanes(ray.direction, direction);
+  __m128 first[3], second[3], third[3];
+  for (int axis = 0; axis < 3; axis++) {
+    first[axis] = _mm_load_ps(block.rows[axis]);
+    second[axis] = _mm_load_ps(block.rows[axis + 3]);
+    third[axis] = _mm_load_ps(block.rows[axis + 6]);
+  }
+
+  int hits;
+  if (block.type == OBJECT_SPHERE) {
+    hits = sphere_lanes(origin, direction, first, second[0], _mm_set1_ps(tmax), t);
+  }
+  else if (block.type == OBJECT_ELLIPSOID) {
+    hits = ellipsoid_lanes(origin, direction, first, second, _mm_set1_ps(tmax), t);
+  }
+  else {
+    __m128 b, g;
+    hits = triangle_lanes(origin, direction, first, second, third, _mm_set1_ps(tmax), t, b, g);
+    _mm_storeu_ps(beta, b);
+    _mm_storeu_ps(gamma, g);
+  }
+  _mm_storeu_ps(distance, t);
+  return hits & ((1 << block.count) - 1);
+}
+#else
+inline int sphere_hit_packet (const Ray_packet &packet, int mask, Vec3 center, float radius,
+                              const float (&tmax)[PACKET_SIZE], float (&distance)[PACKET_SIZE]) {
+  int hits = 0;
+  for (int lane = 0; lane < PACKET_SIZE; lane++) {
+    if ((mask & (1 << lane)) && sphere_hit(packet.rays[lane], center, radius, tmax[lane], distance[lane])) {
+      hits |= 1 << lane;
+    }
+  }
+  return hits;
+}
+
+inline int ellipsoid_hit_packet (const Ray_packet &packet, int mask, Vec3 center, Vec3 radii,
+                                 const float (&tmax)[PACKET_SIZE], float (&distance)[PACKET_SIZE]) {
+  int hits = 0;
+  for (int lane = 0; lane < PACKET_SIZE; lane++) {
+    if ((mask & (1 << lane)) && ellipsoid_hit(packet.rays[lane], center, radii, tmax[lane], distance[lane])) {
+      hits |= 1 << lane;
+    }
+  }
+  return hits;
+}
+
+inline int triangle_hit_packet (const Ray_packet &packet, int mask, Vec3 corner, Vec3 edge1, Vec3 edge2,
+                                const float (&tmax)[PACKET_SIZE], float (&distance)[PACKET_SIZE],
+                                float (&beta)[PACKET_SIZE], float (&gamma)[PACKET_SIZE]) {
+  int hits = 0;
+  for (int lane = 0; lane < PACKET_SIZE; lane++) {
+    if ((mask & (1 << lane)) && triangle_hit(packet.rays[lane], corner, edge1, edge2, tmax[lane], distance[lane], beta[lane], gamma[lane])) {
+      hits |= 1 << lane;
+    }
+  }
+  return hits;
+}
+#endif
+
+// This function tests one ray against every shape of a leaf block, one shape at a time. It is used when SSE isn't
+// available, and by "make test" to check the SSE version.
+inline int block_hits_scalar (const Primitive_block &block, const Ray &ray, float tmax, float (&distance)[LEAF_BLOCK_SIZE],
+                              float (&beta)[LEAF_BLOCK_SIZE], float (&gamma)[LEAF_BLOCK_SIZE]) {
+  int hits = 0;
+  for (int lane = 0; lane < block.count; lane++) {
+    Vec3 first = {block.rows[0][lane], block.rows[1][lane], block.rows[2][lane]};
+    Vec3 second = {block.rows[3][lane], block.rows[4][lane], block.rows[5][lane]};
+    Vec3 third = {block.rows[6][lane], block.rows[7][lane], block.rows[8][lane]};
+    bool hit;
+    if (block.type == OBJECT_SPHERE) {
+      hit = sphere_hit(ray, first, second.x, tmax, distance[lane]);
+    }
+    else if (block.type == OBJECT_ELLIPSOID) {
+      hit = ellipsoid_hit(ray, first, second, tmax, distance[lane]);
+    }
+    else {
+      hit = triangle_hit(ray, first, second, third, tmax, distance[lane], beta[lane], gamma[lane]);
+    }
+    if (hit) {
+      hits |= 1 << lane;
+    }
+  }
+  return hits;
+}
+
+// This function tests one ray against a leaf block with SSE when it is available.
+inline int leaf_block_hits (const Primitive_block &block, const Ray &ray, float tmax, float (&distance)[LEAF_BLOCK_SIZE],
+                            float (&beta)[LEAF_BLOCK_SIZE], float (&gamma)[LEAF_BLOCK_SIZE]) {
+#ifdef __SSE2__
+  return block_hits(block, ray, tmax, distance, beta, gamma);
+#else
+  return block_hits_scalar(block, ray, tmax, distance, beta, gamma);
+#endif
+}
+
+// The pools' tests are defined here so that the accelerators' leaf loops can inline them.
+inline bool Primitive_pool::intersect (int i, const Ray &ray, float tmax, Intersection &hit) {
+  int slot = slots[i];
+  float distance;
+  switch (types[i]) {
+    case OBJECT_SPHERE:
+      if (!sphere_hit(ray, sphere_centers[slot], sphere_radii[slot], tmax, distance)) {
+        return false;
+      }
+      break;
+    case OBJECT_ELLIPSOID:
+      if (!ellipsoid_hit(ray, ellipsoid_centers[slot], ellipsoid_radii[slot], tmax, distance)) {
+        return false;
+      }
+      break;
+    case OBJECT_TRIANGLE:
+      float beta;
+      float gamma;
+      if (!triangle_hit(ray, triangle_corners[slot], triangle_edges1[slot], triangle_edges2[slot], tmax, distance, beta, gamma)) {
+        return false;
+      }
+      hit.barycentric[0] = 1 - beta - gamma;
+      hit.barycentric[1] = beta;
+      hit.barycentric[2] = gamma;
+      break;
+    default:
+      return objects[i]->ray_intersect(ray, tmax, hit);
+  }
+  hit.distance = distance;
+  hit.primitive = objects[i];
+  return true;
+}
+
+// Objects without packet tests, such as instances, are tested one ray at a time.
+inline int Primitive_pool::intersect_packet (int i, const Ray_packet &packet, int mask, const float (&tmax)[PACKET_SIZE],
+                                             Intersection (&hits)[PACKET_SIZE]) {
+  int slot = slots[i];
+  alignas(16) float distance[PACKET_SIZE];
+  int hit_mask = 0;
+  switch (types[i]) {
+    case OBJECT_SPHERE:
+      hit_mask = sphere_hit_packet(packet, mask, sphere_centers[slot], sphere_radii[slot], tmax, distance);
+      break;
+    case OBJECT_ELLIPSOID:
+      hit_mask = ellipsoid_hit_packet(packet, mask, ellipsoid_centers[slot], ellipsoid_radii[slot], tmax, distance);
+      break;
+    case OBJECT_TRIANGLE:
+      alignas(16) float beta[PACKET_SIZE];
+      alignas(16) float gamma[PACKET_SIZE];
+      hit_mask = triangle_hit_packet(packet, mask, triangle_corners[slot], triangle_edges1[slot], triangle_edges2[slot],
+                                     tmax, distance, beta, gamma);
+      for (int lane = 0; lane < PACKET_SIZE; lane++) {
+        if (hit_mask & (1 << lane)) {
+          hits[lane].barycentric[0] = 1 - beta[lane] - gamma[lane];
+          hits[lane].barycentric[1] = beta[lane];
+          hits[lane].barycentric[2] = gamma[lane];
+        }
+      }
+      break;
+    default:
+      for (int lane = 0; lane < PACKET_SIZE; lane++) {
+        if ((mask & (1 << lane)) && objects[i]->ray_intersect(packet.rays[lane], tmax[lane], hits[lane])) {
+          hit_mask |= 1 << lane;
+        }
+      }
+      return hit_mask;
+  }
+  for (int lane = 0; lane < PACKET_SIZE; lane++) {
+    if (hit_mask & (1 << lane)) {
+      hits[lane].distance = distance[lane];
+      hits[lane].primitive = objects[i];
+    }
+  }
+  return hit_mask;
+}
+
+// Shapes are tested here without a virtual call. Other objects, such as instances, decide for themselves how much
+// light they let through.
+inline float Primitive_pool::transmission (int i, const Ray &ray, float tmax) {
+  if (types[i] == OBJECT_OTHER) {
+    return objects[i]->transmission(ray, tmax, opacity(i));
+  }
+  Intersection contact;
+  return intersect(i, ray, tmax, contact) ? 1 - opacity(i) : 1;
+}
+
+inline int Primitive_pool::transmission_packet (int i, const Ray_packet &packet, int mask, const float (&tmax)[PACKET_SIZE],
+                                                float (&passed)[PACKET_SIZE]) {
+  int dimmed = 0;
+  if (types[i] == OBJECT_OTHER) {
+    for (int lane = 0; lane < PACKET_SIZE; lane++) {
+      if (mask & (1 << lane)) {
+        passed[lane] = objects[i]->transmission(packet.rays[lane], tmax[lane], opacity(i));
+        if (passed[lane] < 1) {
+          dimmed |= 1 << lane;
+        }
+      }
+    }
+    return dimmed;
+  }
+  Intersection contacts[PACKET_SIZE];
+  dimmed = intersect_packet(i, packet, mask, tmax, contacts);
+  for (int lane = 0; lane < PACKET_SIZE; lane++) {
+    passed[lane] = 1 - opacity(i);
+  }
+  return dimmed;
+}
+
+// Every shape of a block is tested against the same tmax, and the hits are then taken in order whenever they are closer
+// than the closest so far, which is the same as testing each shape alone with the updated distance.
+inline int Primitive_pool::closest_in_block (int b, const Ray &ray, float &closest_t, Intersection &hit) {
+  Primitive_block &block = blocks[b];
+  if (block.type == OBJECT_OTHER) {
+    if (objects[block.first]->ray_intersect(ray, closest_t, hit)) {
+      closest_t = hit.distance;
+      return block.first;
+    }
+    return -1;
+  }
+
+  alignas(16) float distance[LEAF_BLOCK_SIZE];
+  alignas(16) float beta[LEAF_BLOCK_SIZE];
+  alignas(16) float gamma[LEAF_BLOCK_SIZE];
+  int hits = leaf_block_hits(block, ray, closest_t, distance, beta, gamma);
+  int closest = -1;
+  for (int lane = 0; lane < block.count; lane++) {
+    if ((hits & (1 << lane)) && distance[lane] < closest_t) {
+      closest = lane;
+      closest_t = distance[lane];
+    }
+  }
+  if (closest == -1) {
+    return -1;
+  }
+
+  hit.distance = distance[closest];
+  hit.primitive = objects[block.first + closest];
+  if (block.type == OBJECT_TRIANGLE) {
+    hit.barycentric[0] = 1 - beta[closest] - gamma[closest];
+    hit.barycentric[1] = beta[closest];
+    hit.barycentric[2] = gamma[closest];
+  }
+  return block.first + closest;
+}
+
+inline bool Primitive_pool::occlude_in_block (int b, const Ray &ray, float tmax, float &pass, Object **blocker) {
+  Primitive_block &block = blocks[b];
+  if (block.type == OBJECT_OTHER) {
+    pass = pass*transmission(block.first, ray, tmax);
+    if (pass <= 0) {
+      if (blocker != NULL) {
+        *blocker = objects[block.first];
+      }
+      return true;
+    }
+    return false;
+  }
+
+  alignas(16) float distance[LEAF_BLOCK_SIZE];
+  alignas(16) float beta[LEAF_BLOCK_SIZE];
+  alignas(16) float gamma[LEAF_BLOCK_SIZE];
+  int hits = leaf_block_hits(block, ray, tmax, distance, beta, gamma);
+
+  for (int lane = 0; lane < block.count; lane++) {
+    if (!(hits & (1 << lane))) {
+      continue;
+    }
+    pass = pass*(1 - opacity(block.first + lane));
+    if (pass <= 0) {
+      if (blocker != NULL) {
+        *blocker = objects[block.first + lane];
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+#endif
@@ -0,0 +1,275 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+#include "Primitives.h"
+#include "Vectors.h"
+#include "Objects.h"
+
+using namespace std;
+
+// This program checks that the SSE leaf block and packet tests hit exactly the same shapes, at exactly the same
+// distances and weights, as the single-ray tests. It is built and run by "make test", and returns 1 if any test differs.
+
+#define TEST_TRIALS 200000  // Each kind of test is repeated this many times.
+#define TEST_REPORTS 10  // Only this many differences are printed.
+
+static int failures = 0;
+
+// This returns a random float between low and high.
+static float random_float (float low, float high) {
+  return low + (high - low)*(rand()/(float)RAND_MAX);
+}
+
+static Vec3 random_vector (float low, float high) {
+  return Vec3{random_float(low, high), random_float(low, high), random_float(low, high)};
+}
+
+// This returns a direction that is sometimes parallel to an axis or to an axis plane, since those leave some of the
+// lanes' terms at exactly 0.
+static Vec3 random_direction () {
+  Vec3 direction = random_vector(-1, 1);
+  int choice = rand() % 4;
+  if (choice == 0) {
+    direction = Vec3{0, 0, 0};
+    (&direction.x)[rand() % 3] = rand() % 2 ? 1 : -1;
+  }
+  else if (choice == 1) {
+    (&direction.x)[rand() % 3] = 0;
+  }
+  return direction;
+}
+
+// This fills in one shape of a block. Some triangles have no area, and some spheres and ellipsoids are flat.
+static void random_shape (Primitive_block &block, int lane) {
+  Vec3 fields[3] = {random_vector(-4, 4), random_vector(-3, 3), random_vector(-3, 3)};
+  if (block.type == OBJECT_SPHERE) {
+    fields[1].x = rand() % 8 == 0 ? 0 : random_float(0.1, 3);
+  }
+  else if (block.type == OBJECT_ELLIPSOID) {
+    fields[1] = random_vector(0.1, 3);
+    if (rand() % 8 == 0) {
+      (&fields[1].x)[rand() % 3] = 0;
+    }
+  }
+  else if (rand() % 4 == 0) {
+    int choice = rand() % 3;
+    if (choice == 0) {
+      fields[2] = fields[1]*random_float(-2, 2);
+    }
+    else if (choice == 1) {
+      fields[1] = Vec3{0, 0, 0};
+    }
+    else {
+      fields[1] = Vec3{0, 0, 0};
+      fields[2] = Vec3{0, 0, 0};
+    }
+  }
+  for (int field = 0; field < 3; field++) {
+    block.rows[3*field][lane] = fields[field].x;
+    block.rows[3*field + 1][lane] = fields[field].y;
+    block.rows[3*field + 2][lane] = fields[field].z;
+  }
+}
+
+// This returns a ray aimed at or near a shape. Some rays graze spheres, run along a triangle's plane, start on an
+// edge, or start inside the shape.
+static Ray random_ray (const Primitive_block &block, int lane) {
+  Vec3 first = {block.rows[0][lane], block.rows[1][lane], block.rows[2][lane]};
+  Vec3 second = {block.rows[3][lane], block.rows[4][lane], block.rows[5][lane]};
+  Vec3 third = {block.rows[6][lane], block.rows[7][lane], block.rows[8][lane]};
+  Ray ray;
+  ray.origin = random_vector(-10, 10);
+  Vec3 target = first;
+  int choice = rand() % 5;
+  if (block.type == OBJECT_TRIANGLE) {
+    float beta = random_float(-0.1, 1.1);
+    float gamma = random_float(-0.1, 1.1 - beta);
+    target = first + second*beta + third*gamma;
+    if (choice == 0) {
+      ray.origin = first + second*random_float(-1, 2);
+      ray.direction = third*random_float(-1, 1) + second*random_float(-1, 1);
+      return ray;
+    }
+    if (choice == 1) {
+      ray.origin = first + second*random_float(0, 1);
+    }
+  }
+  else {
+    float radius = block.type == OBJECT_SPHERE ? second.x : second.y;
+    if (choice == 0) {
+      Vec3 side = {0, radius, 0};
+      target = first + side;
+      ray.origin = target + Vec3{random_float(-10, 10), 0, random_float(-10, 10)};
+    }
+    else if (choice == 1) {
+      ray.origin = first;
+    }
+    else {
+      target = target + random_vector(-radius, radius);
+    }
+  }
+  ray.direction = rand() % 4 == 0 ? random_direction() : target - ray.origin;
+  return ray;
+}
+
+static void report (const char *test, int type, int lane, float expected, float found) {
+  failures++;
+  if (failures <= TEST_REPORTS) {
+    printf("%s: shape type %d, lane %d: expected %.9g, found %.9g\n", test, type, lane, expected, found);
+  }
+}
+
+// This compares two results bit for bit, so that NaNs, infinities, and signed zeros must also match.
+static bool same_float (float a, float b) {
+  return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+#ifdef __SSE2__
+// This tests one ray against a random block both ways. Half of the rays have their tmax set to one of the exact
+// distances that the scalar test found, which must be rejected both ways.
+static void test_block (int trial) {
+  Primitive_block block;
+  memset(&block, 0, sizeof(block));
+  block.type = trial % 3 == 0 ? OBJECT_SPHERE : trial % 3 == 1 ? OBJECT_ELLIPSOID : OBJECT_TRIANGLE;
+  block.count = 1 + rand() % LEAF_BLOCK_SIZE;
+  block.first = 0;
+  for (int lane = 0; lane < block.count; lane++) {
+    random_shape(block, lane);
+  }
+  if (rand() % 4 == 0) {
+    for (int row = 0; row < 9; row++) {
+      block.rows[row][block.count - 1] = block.rows[row][0];
+    }
+  }
+  Ray ray = random_ray(block, rand() % block.count);
+  float tmax = rand() % 8 == 0 ? INFINITY : 100;
+
+  float expected_distance[LEAF_BLOCK_SIZE], expected_beta[LEAF_BLOCK_SIZE], expected_gamma[LEAF_BLOCK_SIZE];
+  float distance[LEAF_BLOCK_SIZE], beta[LEAF_BLOCK_SIZE], gamma[LEAF_BLOCK_SIZE];
+  int expected = block_hits_scalar(block, ray, tmax, expected_distance, expected_beta, expected_gamma);
+  if (expected != 0 && rand() % 2 == 0) {
+    int lane = 0;
+    while (!(expected & (1 << lane))) {
+      lane++;
+    }
+    tmax = expected_distance[lane];
+    expected = block_hits_scalar(block, ray, tmax, expected_distance, expected_beta, expected_gamma);
+  }
+  int hits = block_hits(block, ray, tmax, distance, beta, gamma);
+  if (hits != expected) {
+    report("Block hits", block.type, -1, expected, hits);
+    return;
+  }
+  for (int lane = 0; lane < block.count; lane++) {
+    if (!(hits & (1 << lane))) {
+      continue;
+    }
+    if (!same_float(distance[lane], expected_distance[lane])) {
+      report("Block distance", block.type, lane, expected_distance[lane], distance[lane]);
+    }
+    if (block.type == OBJECT_TRIANGLE && !same_float(beta[lane], expected_beta[lane])) {
+      report("Block beta", block.type, lane, expected_beta[lane], beta[lane]);
+    }
+    if (block.type == OBJECT_TRIANGLE && !same_float(gamma[lane], expected_gamma[lane])) {
+      report("Block gamma", block.type, lane, expected_gamma[lane], gamma[lane]);
+    }
+  }
+}
+
+// This tests a packet of random rays against one shape both ways, with some lanes masked off and some lanes' tmax
+// set to their exact distance.
+static void test_packet (int trial) {
+  Primitive_block block;
+  memset(&block, 0, sizeof(block));
+  block.type = trial % 3 == 0 ? OBJECT_SPHERE : trial % 3 == 1 ? OBJECT_ELLIPSOID : OBJECT_TRIANGLE;
+  block.count = 1;
+  random_shape(block, 0);
+  Vec3 first = {block.rows[0][0], block.rows[1][0], block.rows[2][0]};
+  Vec3 second = {block.rows[3][0], block.rows[4][0], block.rows[5][0]};
+  Vec3 third = {block.rows[6][0], block.rows[7][0], block.rows[8][0]};
+
+  Ray_packet packet;
+  alignas(16) float tmax[PACKET_SIZE];
+  int mask = rand() % (1 << PACKET_SIZE);
+  int expected = 0;
+  float expected_distance[PACKET_SIZE], expected_beta[PACKET_SIZE], expected_gamma[PACKET_SIZE];
+  for (int lane = 0; lane < PACKET_SIZE; lane++) {
+    Ray ray = random_ray(block, 0);
+    set_packet_ray(packet, lane, ray);
+    tmax[lane] = rand() % 8 == 0 ? INFINITY : 100;
+    for (int attempt = 0; attempt < 2; attempt++) {
+      bool hit;
+      if (block.type == OBJECT_SPHERE) {
+        hit = sphere_hit(ray, first, second.x, tmax[lane], expected_distance[lane]);
+      }
+      else if (block.type == OBJECT_ELLIPSOID) {
+        hit = ellipsoid_hit(ray, first, second, tmax[lane], expected_distance[lane]);
+      }
+      else {
+        hit = triangle_hit(ray, first, second, third, tmax[lane], expected_distance[lane], expected_beta[lane],
+                           expected_gamma[lane]);
+      }
+      if (attempt == 0 && hit && rand() % 2 == 0) {
+        tmax[lane] = expected_distance[lane];
+        continue;
+      }
+      if (hit && (mask & (1 << lane))) {
+        expected |= 1 << lane;
+      }
+      break;
+    }
+  }
+
+  float distance[PACKET_SIZE], beta[PACKET_SIZE], gamma[PACKET_SIZE];
+  int hits;
+  if (block.type == OBJECT_SPHERE) {
+    hits = sphere_hit_packet(packet, mask, first, second.x, tmax, distance);
+  }
+  else if (block.type == OBJECT_ELLIPSOID) {
+    hits = ellipsoid_hit_packet(packet, mask, first, second, tmax, distance);
+  }
+  else {
+    hits = triangle_hit_packet(packet, mask, first, second, third, tmax, distance, beta, gamma);
+  }
+  if (hits != expected) {
+    report("Packet hits", block.type, -1, expected, hits);
+    return;
+  }
+  for (int lane = 0; lane < PACKET_SIZE; lane++) {
+    if (!(hits & (1 << lane))) {
+      continue;
+    }
+    if (!same_float(distance[lane], expected_distance[lane])) {
+      report("Packet distance", block.type, lane, expected_distance[lane], distance[lane]);
+    }
+    if (block.type == OBJECT_TRIANGLE && !same_float(beta[lane], expected_beta[lane])) {
+      report("Packet beta", block.type, lane, expected_beta[lane], beta[lane]);
+    }
+    if (block.type == OBJECT_TRIANGLE && !same_float(gamma[lane], expected_gamma[lane])) {
+      report("Packet gamma", block.type, lane, expected_gamma[lane], gamma[lane]);
+    }
+  }
+}
+#endif
+
+int main () {
+#ifdef __SSE2__
+  srand(1);
+  for (int trial = 0; trial < TEST_TRIALS; trial++) {
+    test_block(trial);
+  }
+  for (int trial = 0; trial < TEST_TRIALS; trial++) {
+    test_packet(trial);
+  }
+  if (failures > 0) {
+    printf("The SSE tests differed from the single-ray tests %d times.\n", failures);
+    return 1;
+  }
+  printf("The SSE block and packet tests matched the single-ray tests in %d trials each.\n", TEST_TRIALS);
+#else
+  printf("SSE isn't available, so only the single-ray tests are used and there is nothing to compare.\n");
+#endif
+  return 0;
+}
@@ -1,78 +1,130 @@
-#ifndef PROPERTIES_H_
-#define PROPERTIES_H_
-
-#include <cstdlib>
-#include <cstdio>
-#include <vector>
-
-#include "Vectors.h"
-#include "Objects.h"
-#include "Lights.h"
-
-using namespace std;
-
-// These resolve cyclical inclusions.
-class Object;
-class Light;
-
-struct Properties {
-  float eye[3];
-  float viewdir[3];
-  float updir[3];
-  float vfov;
-  int imsize[2];
-  float bkgcolor[3];
-  float refraction_index;
-  bool paralell;
-};
-
-struct Material {
-  float color[3];
-  float k_ads[3];
-  float specular[3];
-  float n;
-  float opacity;
-  float refraction_index;
-};
-
-struct Vertex {
- float x;
- float y;
- float z;
-};
-
-struct Normal {
-  float xd;
-  float yd;
-  float zd;
-};
-
-struct T_coord {
-  float u;
-  float v;
-};
-
-struct Texture {
-  int width;
-  int height;
-  float ***map;
-};
-
-Texture *scan_texture(FILE *tex_ptr);
-
-void delete_objects (vector<Object*> &objects);
-void delete_lights (vector<Light*> &lights);
-void delete_materials (vector<Material*> &materials);
-void delete_textures (vector<Texture*> &textures);
-void delete_vertices (vector<Vertex*> &vertices);
-void delete_normals (vector<Normal*> &normals);
-void delete_t_coords (vector<T_coord*> &t_coords);
-void delete_pixels (int **pixels, int pixel_num);
-
-bool vertex_exists(vector<Vertex*> &vertices, int index);
-bool normal_exists(vector<Normal*> &normals, int index);
-bool t_coord_exists(vector<T_coord*> &t_coords, int index);
-
-int extract_info (FILE *file_ptr, Properties *properties, vector<Object*> &objects, vector<Light*> &lights, vector<Material*> &materials, vector<Texture*> &textures, vector<Vertex*> &vertices, vector<Normal*> &normals, vector<T_coord*> &t_coords);
-
-#endif
+#ifndef PROPERTIES_H_
+#define PROPERTIES_H_
+
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+
+#include "Vectors.h"
+#include "Objects.h"
+#include "Lights.h"
+#include "Arena.h"
+
+using namespace std;
+
+// These resolve cyclical inclusions.
+class Object;
+class Triangle;
+class Light;
+class BVH;
+class Arena;
+
+#define TEXTURE_TILE 8  // Textures are stored in square tiles with this many texels on a side.
+
+struct Properties {
+  float eye[3];
+  float viewdir[3];
+  float updir[3];
+  float vfov;
+  int imsize[2];
+  float bkgcolor[3];
+  float refraction_index;
+  bool paralell;
+  int accelerator;
+  int engine;
+  int frames;
+  float light_cutoff;
+  int light_samples;  // When this is 0, every light is shaded at every point.
+};
+
+struct Material {
+  float color[3];
+  float k_ads[3];
+  float specular[3];
+  float n;
+  float opacity;
+  float refraction_index;
+};
+
+struct T_coord {
+  float u;
+  float v;
+};
+
+// Every triangle's vertices, vertex normals, and texture coordinates are kept in these arrays in the order that the
+// file lists them, and triangles refer to them by index. The store also lists every triangle, so that they can be
+// refreshed after their vertices move.
+struct Triangle_store {
+  vector<Vec3> vertices;
+  vector<Vec3> normals;
+  vector<T_coord> t_coords;
+  vector<Triangle*> triangles;
+};
+
+// A texture's texels are kept in one array of 8-bit red, green, and blue values. The image is split into square tiles
+// that are stored one after another, so texels that are near each other in the image are usually near each other in memory.
+struct Texture {
+  int width;
+  int height;
+  int tiles_across;
+  unsigned char *texels;
+};
+
+// This function returns the position in a texture's array of texel (i, j), where i counts across the image and j counts down it.
+inline size_t texel_offset (Texture *texture, int i, int j) {
+  size_t tile = (i/TEXTURE_TILE) + (size_t)(j/TEXTURE_TILE)*texture->tiles_across;
+  return 3*(tile*TEXTURE_TILE*TEXTURE_TILE + (j % TEXTURE_TILE)*TEXTURE_TILE + (i % TEXTURE_TILE));
+}
+
+// This function converts the color of texel (i, j) back into values between 0 and 1.
+inline void texel_color (Texture *texture, int i, int j, float (&color)[3]) {
+  unsigned char *texel = texture->texels + texel_offset(texture, i, j);
+  color[0] = texel[0]/255.0f;
+  color[1] = texel[1]/255.0f;
+  color[2] = texel[2]/255.0f;
+}
+
+// A texture cache keeps the textures that it has scanned in its own arena, so that a scene that is scanned again can
+// reuse them. Each texture is found by its full path, and is only reused if the file hasn't been modified since.
+struct Cached_texture {
+  vector<char> path;
+  time_t modified;
+  Texture *texture;
+};
+
+struct Texture_cache {
+  Arena arena;
+  vector<Cached_texture> textures;
+  vector<Cached_texture> used;  // Every texture that is looked up is added here, so that the scene using it can tell
+                                // when its file changes.
+};
+
+// A mesh is a named group of triangles that is defined once and placed in the scene by instances.
+struct Mesh {
+  char name[60];
+  vector<Object*> triangles;
+  BVH *bvh;
+};
+
+// A motion moves an object or a vertex by the same amount before every frame after the first.
+// Either object is set, or vertex is the index of a vertex in the triangle store and object is NULL. Vertices ignore the spin.
+struct Motion {
+  Object *object;
+  int vertex;
+  float velocity[3];
+  float spin[3];
+};
+
+Texture *scan_texture(FILE *tex_ptr, Arena &arena);
+void advance_motions (vector<Motion> &motions, Triangle_store &store);
+
+void delete_meshes (vector<Mesh*> &meshes);
+
+bool vertex_exists(Triangle_store &store, int index);
+bool normal_exists(Triangle_store &store, int index);
+bool t_coord_exists(Triangle_store &store, int index);
+
+int extract_info (FILE *file_ptr, Properties *properties, vector<Object*> &objects, vector<Light*> &lights, Arena &arena, Triangle_store &store, vector<Mesh*> &meshes, vector<Motion> &motions, Texture_cache *texture_cache);
+
+#endif
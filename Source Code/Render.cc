@@ -0,0 +1,309 @@
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <algorithm>
+
+#include "Render.h"
+#include "Wavefront.h"
+#include "Vectors.h"
+#include "Objects.h"
+#include "Lights.h"
+#include "Casting.h"
+#include "Properties.h"
+#include "Accelerators.h"
+
+using namespace std;
+
+// This function returns the number of threads used to render, which is the requested number if it is positive.
+int render_threads (int requested) {
+  int threads = requested > 0 ? requested : RENDER_THREADS;
+  if (threads <= 0) {
+    threads = (int)thread::hardware_concurrency();
+  }
+  return max(threads, 1);
+}
+
+// This function builds the viewing window from the eye, view direction, up direction, and vertical field of view.
+void setup_camera (Properties *properties, Camera &camera) {
+  //Pi is used to convert degrees to radians for tan().
+  const float pi = 4.0 * atan(1.0);
+
+  float d = 2; //d is defined arbitrarily here.
+  float h = 2*d*tan((properties->vfov)*pi/360);
+  float w = h*(properties->imsize[0])/(properties->imsize[1]);
+
+  Vec3 eye = {properties->eye[0], properties->eye[1], properties->eye[2]};
+  Vec3 viewdir = unit_vector(Vec3{properties->viewdir[0], properties->viewdir[1], properties->viewdir[2]});
+  Vec3 updir = unit_vector(Vec3{properties->updir[0], properties->updir[1], properties->updir[2]});
+
+  Vec3 u = unit_vector(cross_product(viewdir, updir));
+  Vec3 v = unit_vector(cross_product(u, viewdir));
+
+  Vec3 n = viewdir*d;
+  u = u*(w/2);
+  v = v*(h/2);
+
+  //Once the dimension vectors are defined, the structure of the viewing window is built.
+  Vec3 ul = eye + n - u + v;
+  Vec3 ur = eye + n + u + v;
+  Vec3 ll = eye + n - u - v;
+
+  //The window is stepped across one pixel at a time, starting from the center of the upper-left pixel.
+  camera.eye = eye;
+  camera.ul = ul;
+  camera.hc_change = (ur - ul)*(1.0/(2.0*properties->imsize[0]));
+  camera.vc_change = (ll - ul)*(1.0/(2.0*properties->imsize[1]));
+  camera.h_change = camera.hc_change*2;
+  camera.v_change = camera.vc_change*2;
+}
+
+// This function returns the number of tiles that a frame is split into.
+int tile_count (Properties *properties) {
+  int tiles_across = (properties->imsize[0] + TILE_SIZE - 1)/TILE_SIZE;
+  int tiles_down = (properties->imsize[1] + TILE_SIZE - 1)/TILE_SIZE;
+  return tiles_across*tiles_down;
+}
+
+// This function finds the pixels that a tile covers, from (first_i, first_j) up to but not including (last_i, last_j).
+// Tiles are numbered across each row of tiles, starting from the upper-left corner of the frame.
+void tile_bounds (Properties *properties, int tile, int &first_i, int &first_j, int &last_i, int &last_j) {
+  int tiles_across = (properties->imsize[0] + TILE_SIZE - 1)/TILE_SIZE;
+  first_i = (tile % tiles_across)*TILE_SIZE;
+  first_j = (tile / tiles_across)*TILE_SIZE;
+  last_i = min(first_i + TILE_SIZE, properties->imsize[0]);
+  last_j = min(first_j + TILE_SIZE, properties->imsize[1]);
+}
+
+// This function moves the animated objects to where they are in the next frame and refits the accelerators around
+// them. A hierarchy is only rebuilt once refitting has made it noticeably slower to traverse, in which case this returns true.
+bool advance_frame (vector<Motion> &motions, Triangle_store &store, vector<Mesh*> &meshes, Accelerator *accelerator) {
+  advance_motions(motions, store);
+  for (vector<Mesh*>::iterator i = meshes.begin(); i != meshes.end(); ++i) {
+    (*i)->bvh->update();
+  }
+  return accelerator->update();
+}
+
+// Each thread owns a queue of tiles, which is always a contiguous range of the list of tiles being rendered.
+// The owner takes tiles from the front, and other threads steal from the back, so the two rarely meet.
+struct Tile_queue {
+  mutex lock;
+  int front;
+  int back;
+};
+
+// This function takes the position in the tile list of the next tile in a thread's own queue. It returns -1 if the
+// queue is empty.
+static int take_tile (Tile_queue &queue) {
+  lock_guard<mutex> guard(queue.lock);
+  if (queue.front >= queue.back) {
+    return -1;
+  }
+  return queue.front++;
+}
+
+// This function moves the back half of the fullest other queue into a thread's own queue. Stealing half at once keeps
+// the stolen tiles next to each other, and means that a thread rarely has to steal twice from the same queue.
+// It returns the number of tiles stolen, which is 0 once every other queue is empty.
+static int steal_tiles (vector<Tile_queue> &queues, int thief) {
+  int threads = (int)queues.size();
+  for (int attempt = 0; attempt < threads; attempt++) {
+    int victim = -1;
+    int most = 0;
+    for (int t = 1; t < threads; t++) {
+      Tile_queue &queue = queues[(thief + t) % threads];
+      int remaining;
+      {
+        lock_guard<mutex> guard(queue.lock);
+        remaining = queue.back - queue.front;
+      }
+      if (remaining > most) {
+        most = remaining;
+        victim = (thief + t) % threads;
+      }
+    }
+    if (victim == -1) {
+      return 0;
+    }
+
+    //The victim may have emptied its queue since it was checked, in which case another victim is chosen.
+    int first;
+    int last;
+    {
+      lock_guard<mutex> guard(queues[victim].lock);
+      int remaining = queues[victim].back - queues[victim].front;
+      if (remaining <= 0) {
+        continue;
+      }
+      last = queues[victim].back;
+      first = last - (remaining + 1)/2;
+      queues[victim].back = first;
+    }
+    lock_guard<mutex> guard(queues[thief].lock);
+    queues[thief].front = first;
+    queues[thief].back = last;
+    return last - first;
+  }
+  return 0;
+}
+
+// This function returns the ray from the eye through the center of a pixel.
+Ray camera_ray (Camera &camera, int i, int j) {
+  Vec3 window_point = camera.ul + camera.h_change*i + camera.v_change*j + camera.hc_change + camera.vc_change;
+  return Ray{camera.eye, unit_vector(window_point - camera.eye)};
+}
+
+// This function returns the next tile for a thread to render, stealing more once its own queue is empty.
+// It returns -1 once every queue is empty.
+static int next_tile (const vector<int> &tiles, vector<Tile_queue> &queues, int thief, long &stolen) {
+  while (true) {
+    int position = take_tile(queues[thief]);
+    if (position != -1) {
+      return tiles[position];
+    }
+    int count = steal_tiles(queues, thief);
+    if (count == 0) {
+      return -1;
+    }
+    stolen += count;
+  }
+}
+
+// This function colors one pixel from the closest hit of its camera ray.
+static void shade_pixel (size_t pixel_index, Object *contact, const Ray &ray, const Intersection &hit, Accelerator *accelerator,
+                         Light_tree *light_tree, Properties *properties, Render_state *state, vector<float> &pixels) {
+  state->key.pixel = (unsigned int)pixel_index;
+  state->key.path = 1;
+
+  // This stack holds the indices of refraction of the objects that the ray is inside of, starting with the scene's.
+  Refraction_stack refraction_indices(properties->refraction_index);
+
+  //Once an intersection is or isn't found, the current pixel is colored accordingly.
+  Color color = color_pixel(contact, ray, hit, accelerator, light_tree, properties, refraction_indices, state, 0);
+  pixels[3*pixel_index] = color.r;
+  pixels[3*pixel_index + 1] = color.g;
+  pixels[3*pixel_index + 2] = color.b;
+}
+
+// This function colors every pixel of one tile. Camera rays through neighboring pixels nearly match, so they are
+// traced together in packets that share each box test, and each of their hits is then shaded alone.
+static void render_tile (int tile, Camera &camera, Accelerator *accelerator, Light_tree *light_tree,
+                         Properties *properties, Render_state *state, vector<float> &pixels) {
+  int first_i, first_j, last_i, last_j;
+  tile_bounds(properties, tile, first_i, first_j, last_i, last_j);
+
+  if (!RAY_PACKETS) {
+    //For each pixel, a ray is drawn and used to test for object intersections.
+    for (int j = first_j; j < last_j; j++) {
+      for (int i = first_i; i < last_i; i++) {
+        size_t pixel_index = i + (size_t)j*properties->imsize[0]; //This is used to index the framebuffer.
+        Ray ray = camera_ray(camera, i, j);
+        Intersection hit;
+        Object *contact = closest_intersection(accelerator, ray, hit, state);
+        shade_pixel(pixel_index, contact, ray, hit, accelerator, light_tree, properties, state, pixels);
+      }
+    }
+    return;
+  }
+
+  for (int j = first_j; j < last_j; j += PACKET_WIDTH) {
+    for (int i = first_i; i < last_i; i += PACKET_WIDTH) {
+      // Lanes that fall off the edge of the image trace the packet's first pixel again, but are left out of the mask.
+      Ray_packet packet;
+      size_t pixel_indices[PACKET_SIZE];
+      int mask = 0;
+      for (int lane = 0; lane < PACKET_SIZE; lane++) {
+        int pixel_i = i + lane % PACKET_WIDTH;
+        int pixel_j = j + lane / PACKET_WIDTH;
+        if (pixel_i < last_i && pixel_j < last_j) {
+          mask |= 1 << lane;
+        }
+        else {
+          pixel_i = i;
+          pixel_j = j;
+        }
+        pixel_indices[lane] = pixel_i + (size_t)pixel_j*properties->imsize[0];
+        set_packet_ray(packet, lane, camera_ray(camera, pixel_i, pixel_j));
+      }
+
+      Intersection hits[PACKET_SIZE];
+      Object *contacts[PACKET_SIZE];
+      closest_intersections(accelerator, packet, mask, hits, contacts, state);
+      for (int lane = 0; lane < PACKET_SIZE; lane++) {
+        if (mask & (1 << lane)) {
+          shade_pixel(pixel_indices[lane], contacts[lane], packet.rays[lane], hits[lane], accelerator, light_tree,
+                      properties, state, pixels);
+        }
+      }
+    }
+  }
+}
+
+// Each thread starts with an equal run of neighboring tiles from the list. Reflective and transparent regions take far
+// longer to shade than the rest, so a thread that runs out of tiles steals from the thread with the most left instead
+// of waiting. Each thread shades with its own state, and the scene is only read. Only the listed tiles' pixels are written.
+void render_tiles (Camera &camera, Accelerator *accelerator, Light_tree *light_tree, Properties *properties, int frame,
+                   const vector<int> &tiles, vector<Render_state> &states, vector<float> &pixels, Render_stats &stats) {
+  int count = (int)tiles.size();
+  int threads = max(1, min((int)states.size(), count));
+
+  vector<Tile_queue> queues(threads);
+  for (int t = 0; t < threads; t++) {
+    queues[t].front = (int)((long)count*t/threads);
+    queues[t].back = (int)((long)count*(t + 1)/threads);
+  }
+  vector<long> stolen(threads, 0);
+  for (int t = 0; t < threads; t++) {
+    states[t].key.frame = frame;
+  }
+
+  auto work = [&](int t) {
+    if (properties->engine == ENGINE_WAVEFRONT) {
+      // The wavefront engine takes several tiles at once, so that each of its queues holds more rays to sort.
+      while (true) {
+        int batch[WAVEFRONT_TILES];
+        int batch_size = 0;
+        while (batch_size < WAVEFRONT_TILES && (batch[batch_size] = next_tile(tiles, queues, t, stolen[t])) != -1) {
+          batch_size++;
+        }
+        if (batch_size == 0) {
+          return;
+        }
+        render_wavefront(*states[t].wavefront, batch, batch_size, camera, accelerator, light_tree, properties, &states[t], pixels);
+      }
+    }
+
+    int tile;
+    while ((tile = next_tile(tiles, queues, t, stolen[t])) != -1) {
+      render_tile(tile, camera, accelerator, light_tree, properties, &states[t], pixels);
+    }
+  };
+
+  //The calling thread renders alongside the others rather than waiting for them.
+  vector<thread> workers;
+  for (int t = 1; t < threads; t++) {
+    workers.push_back(thread(work, t));
+  }
+  work(0);
+  for (unsigned int t = 0; t < workers.size(); t++) {
+    workers[t].join();
+  }
+
+  stats.tiles = count;
+  stats.tiles_stolen = 0;
+  for (int t = 0; t < threads; t++) {
+    stats.tiles_stolen += stolen[t];
+  }
+}
+
+// This function renders every tile of a frame.
+void render_frame (Camera &camera, Accelerator *accelerator, Light_tree *light_tree, Properties *properties,
+                   int frame, vector<Render_state> &states, vector<float> &pixels, Render_stats &stats) {
+  vector<int> tiles(tile_count(properties));
+  for (unsigned int tile = 0; tile < tiles.size(); tile++) {
+    tiles[tile] = tile;
+  }
+  render_tiles(camera, accelerator, light_tree, properties, frame, tiles, states, pixels, stats);
+}
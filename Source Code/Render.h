@@ -0,0 +1,62 @@
+#ifndef RENDER_H_
+#define RENDER_H_
+
+#include <cstdlib>
+#include <vector>
+
+#include "Vectors.h"
+#include "Casting.h"
+#include "Properties.h"
+#include "Accelerators.h"
+
+using namespace std;
+
+// These resolve cyclical includes.
+class Light_tree;
+struct Properties;
+
+// These macros control how frames are split between threads.
+#define TILE_SIZE 16  // Frames are rendered in square tiles with this many pixels on a side.
+#define RENDER_THREADS 0  // Frames are rendered with this many threads, or with one per core when this is 0.
+#define RAY_PACKETS 1  // Camera rays are traced in packets of neighboring pixels when this is 1, and one at a time when it is 0.
+#define PACKET_WIDTH 2  // Packets of camera rays are squares of pixels this wide, which fill the PACKET_SIZE rays of a packet.
+
+// These name the ways that pixels can be colored.
+#define ENGINE_RECURSIVE 0  // Each pixel's reflected and transmitted rays are followed depth-first before the next pixel.
+#define ENGINE_WAVEFRONT 1  // Batches of tiles are traced one bounce at a time, with every ray of a bounce queued and sorted together.
+
+// This holds the eye and the steps between pixel centers on the viewing window, starting from its upper-left corner.
+struct Camera {
+  Vec3 eye;
+  Vec3 ul;
+  Vec3 hc_change;  // These are half of a pixel's width and height.
+  Vec3 vc_change;
+  Vec3 h_change;  // These are a whole pixel's width and height.
+  Vec3 v_change;
+};
+
+// This describes how the tiles of the last frame were shared between the threads.
+struct Render_stats {
+  int tiles;
+  long tiles_stolen;
+};
+
+int render_threads(int requested);
+
+int tile_count(Properties *properties);
+
+void tile_bounds(Properties *properties, int tile, int &first_i, int &first_j, int &last_i, int &last_j);
+
+bool advance_frame(vector<Motion> &motions, Triangle_store &store, vector<Mesh*> &meshes, Accelerator *accelerator);
+
+void setup_camera(Properties *properties, Camera &camera);
+
+Ray camera_ray(Camera &camera, int i, int j);
+
+void render_tiles(Camera &camera, Accelerator *accelerator, Light_tree *light_tree, Properties *properties, int frame,
+                  const vector<int> &tiles, vector<Render_state> &states, vector<float> &pixels, Render_stats &stats);
+
+void render_frame(Camera &camera, Accelerator *accelerator, Light_tree *light_tree, Properties *properties,
+                  int frame, vector<Render_state> &states, vector<float> &pixels, Render_stats &stats);
+
+#endif
@@ -1,190 +1,113 @@
-#include <cstdlib>
-#include <cmath>
-
-#include "Vectors.h"
-#include "Casting.h"
-#include "Objects.h"
-#include "Properties.h"
-
-using namespace std;
-
-// These functions all make use of barycentric coordinates.
-
-Intersection *Triangle::ray_intersect(Vector *ray) {
-  float distance = 0;
-
-  Vector *e1 = new_vector(v1->x, v1->y, v1->z, v2->x, v2->y, v2->z);
-  Vector *e2 = new_vector(v1->x, v1->y, v1->z, v3->x, v3->y, v3->z);
-  Vector *n = cross_product(e1, e2);
-
-  float d = -(n->xd*v1->x + n->yd*v1->y + n->zd*v1->z);
-
-  float denominator = (n->xd*ray->xd + n->yd*ray->yd + n->zd*ray->zd);
-
-  if (denominator != 0) {
-    float numerator = -(n->xd*ray->x + n->yd*ray->y + n->zd*ray->z + d);
-    distance = numerator/denominator;
-
-    float px = ray->x + distance*ray->xd;
-    float py = ray->y + distance*ray->yd;
-    float pz = ray->z + distance*ray->zd;
-
-    Vector *e1_x_e2 = cross_product(e1, e2);
-    float total_area = 0.5*vector_length(e1_x_e2);
-
-    Vector *e3 = new_vector(v2->x, v2->y, v2->z, px, py, pz);
-    Vector *e4 = new_vector(v3->x, v3->y, v3->z, px, py, pz);
-
-    Vector *e3_x_e4 = cross_product(e3, e4);
-    Vector *e4_x_e2 = cross_product(e4, e2);
-    Vector *e1_x_e3 = cross_product(e1, e3);
-
-    float area_a = 0.5*vector_length(e3_x_e4);
-    float area_b = 0.5*vector_length(e4_x_e2);
-    float area_c = 0.5*vector_length(e1_x_e3);
-
-    delete e3;
-    delete e4;
-    delete e1_x_e2;
-    delete e3_x_e4;
-    delete e4_x_e2;
-    delete e1_x_e3;
-
-    float alpha = area_a/total_area;
-    float beta = area_b/total_area;
-    float gamma = area_c/total_area;
-
-    float epsilon = 0.00001;
-
-    if ((0 <= alpha && alpha <= 1) && (0 <= beta && beta <= 1) && (0 <= gamma && gamma <= 1) && (alpha + beta + gamma - 1 < epsilon)) {
-      delete e1;
-      delete e2;
-      delete n;
-
-      Intersection *contact = new Intersection;
-      contact->x = px;
-      contact->y = py;
-      contact->z = pz;
-      contact->distance = distance;
-      return contact;
-    }
-  }
-  
-  delete e1;
-  delete e2;
-  delete n;
-
-  // An invalid intersection is returned if the point lies outside the triangle.
-  Intersection *contact = new Intersection;
-  contact->x = -1;
-  contact->y = -1;
-  contact->z = -1;
-  contact->distance = -1;
-  return contact;
-}
-
-
-Vector *Triangle::find_normal(Intersection *intersection) {
-  Vector *e1 = new_vector(v1->x, v1->y, v1->z, v2->x, v2->y, v2->z);
-  Vector *e2 = new_vector(v1->x, v1->y, v1->z, v3->x, v3->y, v3->z);
-  Vector *n = cross_product(e1, e2);
-
-  if (n1 == NULL || n2 == NULL || n3 == NULL) {
-    delete e1;
-    delete e2;
-    unit_vector(n);
-    return n;
-  }
-
-  float px = intersection->x;
-  float py = intersection->y;
-  float pz = intersection->z;
-
-  Vector *e1_x_e2 = cross_product(e1, e2);
-  float total_area = 0.5*vector_length(e1_x_e2);
-
-  Vector *e3 = new_vector(v2->x, v2->y, v2->z, px, py, pz);
-  Vector *e4 = new_vector(v3->x, v3->y, v3->z, px, py, pz);
-
-  Vector *e3_x_e4 = cross_product(e3, e4);
-  Vector *e4_x_e2 = cross_product(e4, e2);
-  Vector *e1_x_e3 = cross_product(e1, e3);
-
-  float area_a = 0.5*vector_length(e3_x_e4);
-  float area_b = 0.5*vector_length(e4_x_e2);
-  float area_c = 0.5*vector_length(e1_x_e3);
-
-  delete n;
-  delete e1;
-  delete e2;
-  delete e3;
-  delete e4;
-  delete e1_x_e2;
-  delete e3_x_e4;
-  delete e4_x_e2;
-  delete e1_x_e3;
-
-  float alpha = area_a/total_area;
-  float beta = area_b/total_area;
-  float gamma = area_c/total_area;
-
-  Vector *normal = new Vector;
-  normal->x = intersection->x;
-  normal->y = intersection->y;
-  normal->z = intersection->z;
-  normal->xd = alpha*n1->xd + beta*n2->xd + gamma*n3->xd;
-  normal->yd = alpha*n1->yd + beta*n2->yd + gamma*n3->yd;
-  normal->zd = alpha*n1->zd + beta*n2->zd + gamma*n3->zd;
-  normal->distance = 0;
-  unit_vector(normal);
-  return normal;
-}
-
-
-void Triangle::texture_color(Intersection *intersection, float (&color)[3]) {
-  Vector *e1 = new_vector(v1->x, v1->y, v1->z, v2->x, v2->y, v2->z);
-  Vector *e2 = new_vector(v1->x, v1->y, v1->z, v3->x, v3->y, v3->z);
-  Vector *n = cross_product(e1, e2);
-
-  float px = intersection->x;
-  float py = intersection->y;
-  float pz = intersection->z;
-
-  Vector *e1_x_e2 = cross_product(e1, e2);
-  float total_area = 0.5*vector_length(e1_x_e2);
-
-  Vector *e3 = new_vector(v2->x, v2->y, v2->z, px, py, pz);
-  Vector *e4 = new_vector(v3->x, v3->y, v3->z, px, py, pz);
-
-  Vector *e3_x_e4 = cross_product(e3, e4);
-  Vector *e4_x_e2 = cross_product(e4, e2);
-  Vector *e1_x_e3 = cross_product(e1, e3);
-
-  float area_a = 0.5*vector_length(e3_x_e4);
-  float area_b = 0.5*vector_length(e4_x_e2);
-  float area_c = 0.5*vector_length(e1_x_e3);
-
-  delete n;
-  delete e1;
-  delete e2;
-  delete e3;
-  delete e4;
-  delete e1_x_e2;
-  delete e3_x_e4;
-  delete e4_x_e2;
-  delete e1_x_e3;
-
-  float alpha = area_a/total_area;
-  float beta = area_b/total_area;
-  float gamma = area_c/total_area;
-
-  float u = alpha*t1->u + beta*t2->u + gamma*t3->u;
-  float v = alpha*t1->v + beta*t2->v + gamma*t3->v;
-
-  int i = (int)round(u*(texture->width - 1));
-  int j = (int)round(v*(texture->height - 1));
-  color[0] = texture->map[i][j][0];
-  color[1] = texture->map[i][j][1];
-  color[2] = texture->map[i][j][2];
-  return;
-}
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+#include "Vectors.h"
+#include "Casting.h"
+#include "Objects.h"
+#include "Properties.h"
+#include "Primitives.h"
+
+using namespace std;
+
+Triangle::Triangle (Triangle_store *store_ptr, uint32_t (&vertex_v)[3], uint32_t (&normal_v)[3], uint32_t (&t_coord_v)[3],
+                    Material *mat_ptr, Texture *tex_ptr) : Object(mat_ptr, tex_ptr), store(store_ptr) {
+  for (int i = 0; i < 3; i++) {
+    vertices[i] = vertex_v[i];
+    normals[i] = normal_v[i];
+    t_coords[i] = t_coord_v[i];
+  }
+  refresh();
+}
+
+// This function recomputes a triangle's edges and plane normal from its vertices. It is called again after the vertices move.
+void Triangle::refresh() {
+  corner = store->vertices[vertices[0]];
+  edge1 = store->vertices[vertices[1]] - corner;
+  edge2 = store->vertices[vertices[2]] - corner;
+  plane_normal = unit_vector(cross_product(edge1, edge2));
+}
+
+// The weights of the second and third vertices come out of the hit test, and the first vertex's weight is what remains.
+bool Triangle::ray_intersect(const Ray &ray, float tmax, Intersection &hit) {
+  float distance;
+  float beta;
+  float gamma;
+  if (!triangle_hit(ray, corner, edge1, edge2, tmax, distance, beta, gamma)) {
+    return false;
+  }
+  hit.distance = distance;
+  hit.barycentric[0] = 1 - beta - gamma;
+  hit.barycentric[1] = beta;
+  hit.barycentric[2] = gamma;
+  hit.primitive = this;
+  return true;
+}
+
+
+// Triangles without vertex normals are flat, so their normal is the same everywhere. Smooth triangles blend
+// their vertex normals with the weights that were found when the triangle was hit.
+void Triangle::complete_hit(const Ray &ray, Intersection &hit) {
+  hit.point = ray.origin + ray.direction*hit.distance;
+  hit.geometric_normal = plane_normal;
+
+  if (normals[0] == NO_INDEX) {
+    hit.normal = hit.geometric_normal;
+    return;
+  }
+
+  Vec3 &n1 = store->normals[normals[0]];
+  Vec3 &n2 = store->normals[normals[1]];
+  Vec3 &n3 = store->normals[normals[2]];
+  hit.normal = unit_vector(n1*hit.barycentric[0] + n2*hit.barycentric[1] + n3*hit.barycentric[2]);
+  if (dot_product(hit.geometric_normal, hit.normal) < 0) {
+    hit.geometric_normal = -hit.geometric_normal;
+  }
+}
+
+
+// This function finds the texture coordinates at a hit. It returns false if the triangle has none.
+bool Triangle::texture_coordinates(const Intersection &hit, float &u, float &v) {
+  if (t_coords[0] == NO_INDEX) {
+    return false;
+  }
+
+  T_coord &t1 = store->t_coords[t_coords[0]];
+  T_coord &t2 = store->t_coords[t_coords[1]];
+  T_coord &t3 = store->t_coords[t_coords[2]];
+  u = hit.barycentric[0]*t1.u + hit.barycentric[1]*t2.u + hit.barycentric[2]*t3.u;
+  v = hit.barycentric[0]*t1.v + hit.barycentric[1]*t2.v + hit.barycentric[2]*t3.v;
+  return true;
+}
+
+
+void Triangle::texture_color(const Intersection &hit, float (&color)[3]) {
+  float u;
+  float v;
+  // Triangles without texture coordinates keep their material's color.
+  if (!texture_coordinates(hit, u, v)) {
+    color[0] = material->color[0];
+    color[1] = material->color[1];
+    color[2] = material->color[2];
+    return;
+  }
+
+  int i = (int)round(u*(texture->width - 1));
+  int j = (int)round(v*(texture->height - 1));
+  texel_color(texture, i, j, color);
+  return;
+}
+
+// This function returns the box that encloses a triangle's three vertices.
+void Triangle::bounds(float (&min)[3], float (&max)[3]) {
+  Vec3 &a = store->vertices[vertices[0]];
+  Vec3 &b = store->vertices[vertices[1]];
+  Vec3 &c = store->vertices[vertices[2]];
+  min[0] = std::min(a.x, std::min(b.x, c.x));
+  min[1] = std::min(a.y, std::min(b.y, c.y));
+  min[2] = std::min(a.z, std::min(b.z, c.z));
+  max[0] = std::max(a.x, std::max(b.x, c.x));
+  max[1] = std::max(a.y, std::max(b.y, c.y));
+  max[2] = std::max(a.z, std::max(b.z, c.z));
+  return;
+}
@@ -1,34 +1,81 @@
-#ifndef VECTORS_H_
-#define VECTORS_H_
-
-#include <cstdlib>
-
-using namespace std;
-
-struct Vector {
-  // This represents the "origin" and distance for use as a ray.
-  float x;
-  float y;
-  float z;
-  float distance;
-
-  // This is the true vector component.
-  float xd;
-  float yd;
-  float zd;
-};
-
-Vector *new_vector(float x1, float y1, float z1, float x2, float y2, float z2);
-Vector *copy_vector(Vector *vector);
-
-float vector_length(Vector *vector);
-void scale_vector(Vector *vector, float scalar);
-void unit_vector(Vector *vector);
-
-Vector *add_vectors(Vector *vector1, Vector *vector2);
-Vector *subtract_vectors(Vector *vector1, Vector *vector2);
-
-float dot_product(Vector *vector1, Vector *vector2);
-Vector *cross_product(Vector *vector1, Vector *vector2);
-
-#endif
+#ifndef VECTORS_H_
+#define VECTORS_H_
+
+#include <cstdlib>
+#include <cmath>
+
+using namespace std;
+
+// Vectors and rays are small enough to be passed and returned by value, so none of these operations allocate memory.
+struct Vec3 {
+  float x;
+  float y;
+  float z;
+};
+
+// A ray starts at its origin and points along its direction, which is unit length for every ray that the renderer traces.
+struct Ray {
+  Vec3 origin;
+  Vec3 direction;
+};
+
+#define PACKET_SIZE 4  // Packets hold this many rays, which is as many floats as fit in one SSE register.
+
+// A packet holds several rays that are traced together. Each coordinate is stored for every ray side by side so that
+// all of the rays can be tested at once, and the rays are also kept whole for objects that are tested one ray at a time.
+struct alignas(16) Ray_packet {
+  float origin[3][PACKET_SIZE];
+  float direction[3][PACKET_SIZE];
+  Ray rays[PACKET_SIZE];
+};
+
+// This function stores a ray in one lane of a packet.
+inline void set_packet_ray (Ray_packet &packet, int lane, const Ray &ray) {
+  packet.origin[0][lane] = ray.origin.x;
+  packet.origin[1][lane] = ray.origin.y;
+  packet.origin[2][lane] = ray.origin.z;
+  packet.direction[0][lane] = ray.direction.x;
+  packet.direction[1][lane] = ray.direction.y;
+  packet.direction[2][lane] = ray.direction.z;
+  packet.rays[lane] = ray;
+}
+
+constexpr Vec3 operator+ (Vec3 a, Vec3 b) {
+  return Vec3{a.x + b.x, a.y + b.y, a.z + b.z};
+}
+
+constexpr Vec3 operator- (Vec3 a, Vec3 b) {
+  return Vec3{a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+constexpr Vec3 operator- (Vec3 a) {
+  return Vec3{-a.x, -a.y, -a.z};
+}
+
+constexpr Vec3 operator* (Vec3 a, float scalar) {
+  return Vec3{a.x*scalar, a.y*scalar, a.z*scalar};
+}
+
+constexpr Vec3 operator* (float scalar, Vec3 a) {
+  return Vec3{a.x*scalar, a.y*scalar, a.z*scalar};
+}
+
+constexpr float dot_product (Vec3 a, Vec3 b) {
+  return (a.x*b.x) + (a.y*b.y) + (a.z*b.z);
+}
+
+constexpr Vec3 cross_product (Vec3 a, Vec3 b) {
+  return Vec3{(a.y*b.z) - (a.z*b.y), (a.z*b.x) - (a.x*b.z), (a.x*b.y) - (a.y*b.x)};
+}
+
+// The squares are summed in double precision, so that the lengths of long rays aren't rounded twice.
+inline float vector_length (Vec3 a) {
+  return sqrt((double)a.x*a.x + (double)a.y*a.y + (double)a.z*a.z);
+}
+
+// This function returns a vector with the same direction and unit length.
+inline Vec3 unit_vector (Vec3 a) {
+  return a*(1/vector_length(a));
+}
+
+#endif
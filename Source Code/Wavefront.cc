@@ -0,0 +1,329 @@
+#include <cstdlib>
+#include <cmath>
+#include <cfloat>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include "Wavefront.h"
+#include "Render.h"
+#include "Vectors.h"
+#include "Objects.h"
+#include "Lights.h"
+#include "Casting.h"
+#include "Properties.h"
+#include "Accelerators.h"
+
+using namespace std;
+
+// This is how far a ray's octant is shifted in its sort key, above the bits of its origin's cell.
+#define ORIGIN_BITS (3*WAVEFRONT_SORT_BITS)
+
+// This function widens a box to hold a ray's origin.
+static void add_origin (const Ray &ray, float (&min)[3], float (&max)[3]) {
+  float origin[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+  for (int axis = 0; axis < 3; axis++) {
+    min[axis] = std::min(min[axis], origin[axis]);
+    max[axis] = std::max(max[axis], origin[axis]);
+  }
+}
+
+// This function finds how far apart the grid's cells are on each axis, so that the box is divided evenly between them.
+static void cell_scale (float (&min)[3], float (&max)[3], float (&scale)[3]) {
+  const float cells = (float)(1 << WAVEFRONT_SORT_BITS);
+  for (int axis = 0; axis < 3; axis++) {
+    float extent = max[axis] - min[axis];
+    scale[axis] = extent > 0 ? (cells - 1)/extent : 0;
+  }
+}
+
+// This function returns a ray's sort key. Rays are sorted by the octant that they head into, and then along a Morton
+// curve through the grid's cells, so that rays which start near each other and head the same way are traced together.
+static unsigned long long ray_key (const Ray &ray, float (&min)[3], float (&scale)[3]) {
+  float origin[3] = {ray.origin.x, ray.origin.y, ray.origin.z};
+  unsigned long long key = 0;
+  for (int axis = 0; axis < 3; axis++) {
+    unsigned int cell = (unsigned int)((origin[axis] - min[axis])*scale[axis]);
+    for (int bit = 0; bit < WAVEFRONT_SORT_BITS; bit++) {
+      key |= (unsigned long long)((cell >> bit) & 1) << (3*bit + axis);
+    }
+  }
+  unsigned long long octant = (ray.direction.x < 0) | (ray.direction.y < 0) << 1 | (ray.direction.z < 0) << 2;
+  return octant << ORIGIN_BITS | key;
+}
+
+// This function returns the slot of a path vertex that a ray from the given queue fills in.
+static Color &slot_color (Path_vertex &vertex, int type) {
+  return type == WAVE_REFLECTION ? vertex.reflected : vertex.transmitted;
+}
+
+// This function makes a path vertex for a ray's hit. Unless the vertex is at the maximum depth, its reflected and
+// transmitted rays are queued for the next bounce, except for those whose colors would be weighted by nothing.
+static void add_vertex (Wavefront &wavefront, const Wave_ray &ray, int type, Object *target, const Intersection &hit,
+                        int depth, Properties *properties) {
+  Path_vertex vertex;
+  vertex.target = target;
+  vertex.hit = hit;
+  Vec3 eye = {properties->eye[0], properties->eye[1], properties->eye[2]};
+  vertex.view = unit_vector(eye - hit.point);
+  surface_color(target, hit, vertex.color);
+  vertex.light_sum[0] = vertex.light_sum[1] = vertex.light_sum[2] = 0;
+  vertex.reflected = Color{0, 0, 0};
+  vertex.transmitted = Color{0, 0, 0};
+  vertex.traces_rays = depth < MAX_DEPTH;
+  vertex.parent = ray.parent;
+  vertex.type = type;
+  vertex.pixel = ray.pixel;
+  vertex.path = ray.path;
+
+  int index = (int)wavefront.vertices.size();
+  if (vertex.traces_rays) {
+    Scattering scattering(ray.refraction_indices);
+    scatter_rays(target, ray.ray, hit, scattering);
+    vertex.reflection_weight = scattering.reflection_weight;
+    vertex.transmission_weight = scattering.transmission_weight;
+
+    float throughput = ray.throughput*scattering.reflection_weight;
+    if (fabs(throughput) > WAVEFRONT_MIN_THROUGHPUT) {
+      wavefront.next_queues[WAVE_REFLECTION].push_back(Wave_ray{scattering.reflection_ray, scattering.reflection_indices,
+                                                                 throughput, index, ray.pixel, 2*ray.path});
+    }
+    throughput = ray.throughput*scattering.transmission_weight;
+    if (scattering.transmits && fabs(throughput) > WAVEFRONT_MIN_THROUGHPUT) {
+      wavefront.next_queues[WAVE_TRANSMISSION].push_back(Wave_ray{scattering.transmitted_ray, scattering.transmission_indices,
+                                                                   throughput, index, ray.pixel, 2*ray.path + 1});
+    }
+  }
+  else {
+    vertex.reflection_weight = 0;
+    vertex.transmission_weight = 0;
+  }
+  wavefront.vertices.push_back(vertex);
+}
+
+// This function traces the closest hits of one queue's rays and makes a path vertex for each hit. Rays that miss
+// return the background color at once. Camera rays are queued in packets of neighboring pixels, so they are traced
+// in order, while the other queues are sorted first so that each packet holds rays that follow nearly the same path.
+static void trace_queue (Wavefront &wavefront, int type, int depth, Accelerator *accelerator, Properties *properties,
+                         Render_state *state, vector<float> &pixels) {
+  vector<Wave_ray> &queue = wavefront.queues[type];
+  vector<pair<unsigned long long, int> > &order = wavefront.order;
+  order.clear();
+  if (type == WAVE_CAMERA) {
+    for (unsigned int i = 0; i < queue.size(); i++) {
+      order.push_back(make_pair(0ULL, (int)i));
+    }
+  }
+  else {
+    float min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    float max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (unsigned int i = 0; i < queue.size(); i++) {
+      add_origin(queue[i].ray, min, max);
+    }
+    float scale[3];
+    cell_scale(min, max, scale);
+    for (unsigned int i = 0; i < queue.size(); i++) {
+      order.push_back(make_pair(ray_key(queue[i].ray, min, scale), (int)i));
+    }
+    sort(order.begin(), order.end());
+  }
+
+  Color background = {properties->bkgcolor[0], properties->bkgcolor[1], properties->bkgcolor[2]};
+  int count = (int)order.size();
+  for (int first = 0; first < count; first += PACKET_SIZE) {
+    // Unused lanes repeat the first ray so that every lane holds real numbers.
+    Ray_packet packet;
+    int rays[PACKET_SIZE];
+    int mask = 0;
+    for (int lane = 0; lane < PACKET_SIZE; lane++) {
+      if (first + lane < count) {
+        rays[lane] = order[first + lane].second;
+        mask |= 1 << lane;
+      }
+      else {
+        rays[lane] = rays[0];
+      }
+      set_packet_ray(packet, lane, queue[rays[lane]].ray);
+    }
+
+    Intersection hits[PACKET_SIZE];
+    Object *contacts[PACKET_SIZE];
+    int hit_mask = closest_intersections(accelerator, packet, mask, hits, contacts, state);
+    for (int lane = 0; lane < PACKET_SIZE; lane++) {
+      if (!(mask & (1 << lane))) {
+        continue;
+      }
+      Wave_ray &ray = queue[rays[lane]];
+      if (hit_mask & (1 << lane)) {
+        add_vertex(wavefront, ray, type, contacts[lane], hits[lane], depth, properties);
+      }
+      else if (ray.parent == -1) {
+        pixels[3*(size_t)ray.pixel] = background.r;
+        pixels[3*(size_t)ray.pixel + 1] = background.g;
+        pixels[3*(size_t)ray.pixel + 2] = background.b;
+      }
+      else {
+        slot_color(wavefront.vertices[ray.parent], type) = background;
+      }
+    }
+  }
+}
+
+// This function traces the shadow rays of every light request. The rays are sorted by light first, so that each
+// light's rays are traced together with its shadow cache, and then by octant and origin like the other queues.
+static void trace_shadows (Wavefront &wavefront, int ray_count, Accelerator *accelerator, Render_state *state) {
+  vector<pair<unsigned long long, int> > &order = wavefront.order;
+  order.clear();
+  float min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+  float max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+  for (int i = 0; i < ray_count; i++) {
+    add_origin(wavefront.shadow_rays[i], min, max);
+  }
+  float scale[3];
+  cell_scale(min, max, scale);
+  for (vector<Light_request>::iterator r = wavefront.requests.begin(); r != wavefront.requests.end(); ++r) {
+    for (int i = r->first_ray; i < r->first_ray + r->ray_count; i++) {
+      unsigned long long light = (unsigned long long)r->light << (ORIGIN_BITS + 3);
+      order.push_back(make_pair(light | ray_key(wavefront.shadow_rays[i], min, scale), i));
+    }
+  }
+  sort(order.begin(), order.end());
+
+  int first = 0;
+  while (first < ray_count) {
+    int light = (int)(order[first].first >> (ORIGIN_BITS + 3));
+    int last = first;
+    wavefront.sorted_rays.clear();
+    wavefront.sorted_distances.clear();
+    while (last < ray_count && (int)(order[last].first >> (ORIGIN_BITS + 3)) == light) {
+      wavefront.sorted_rays.push_back(wavefront.shadow_rays[order[last].second]);
+      wavefront.sorted_distances.push_back(wavefront.shadow_distances[order[last].second]);
+      last++;
+    }
+    wavefront.sorted_passes.resize(last - first);
+    cached_occlusions(accelerator, &wavefront.sorted_rays[0], &wavefront.sorted_distances[0], last - first,
+                      state->shadow_caches[light], &wavefront.sorted_passes[0]);
+    for (int i = first; i < last; i++) {
+      wavefront.shadow_passes[order[i].second] = wavefront.sorted_passes[i - first];
+    }
+    first = last;
+  }
+}
+
+// This function shades the path vertices from first_vertex on. Every vertex chooses its lights and queues their shadow
+// rays, the whole shadow queue is traced, and each light's illumination is then added in the order it was chosen.
+static void shade_vertices (Wavefront &wavefront, int first_vertex, Accelerator *accelerator, Light_tree *light_tree,
+                            Properties *properties, Render_state *state) {
+  vector<Light*> &lights = light_tree->get_lights();
+  wavefront.requests.clear();
+  int ray_count = 0;
+  for (int v = first_vertex; v < (int)wavefront.vertices.size(); v++) {
+    Path_vertex &vertex = wavefront.vertices[v];
+    state->key.pixel = (unsigned int)vertex.pixel;
+    state->key.path = vertex.path;
+    choose_lights(light_tree, properties, vertex.hit, state, state->light_choices);
+    for (vector<Light_choice>::iterator c = state->light_choices.begin(); c != state->light_choices.end(); ++c) {
+      if ((int)wavefront.shadow_rays.size() < ray_count + shadow_ray_count()) {
+        wavefront.shadow_rays.resize(2*(ray_count + shadow_ray_count()));
+        wavefront.shadow_distances.resize(wavefront.shadow_rays.size());
+        wavefront.shadow_passes.resize(wavefront.shadow_rays.size());
+      }
+      Light_request request = {v, c->light, c->weight, 0, ray_count, 0};
+      request.ray_count = lights[c->light]->shadow_rays(vertex.hit, state->key, c->light, c->sample, &wavefront.shadow_rays[ray_count],
+                                                        &wavefront.shadow_distances[ray_count], request.ray_passes);
+      ray_count += request.ray_count;
+      wavefront.requests.push_back(request);
+    }
+  }
+
+  trace_shadows(wavefront, ray_count, accelerator, state);
+
+  // Each light's traced rays are summed in the order that they were made, just as one light's rays are summed alone.
+  for (vector<Light_request>::iterator r = wavefront.requests.begin(); r != wavefront.requests.end(); ++r) {
+    Path_vertex &vertex = wavefront.vertices[r->vertex];
+    if (r->ray_count > 0) {
+      float sum = 0;
+      for (int i = r->first_ray; i < r->first_ray + r->ray_count; i++) {
+        sum += wavefront.shadow_passes[i];
+      }
+      r->ray_passes += sum;
+    }
+    float shadow_constant = r->ray_passes/shadow_ray_count();
+    add_illumination(vertex.target, lights[r->light], vertex.hit, vertex.view, vertex.color, vertex.light_sum,
+                     r->weight, shadow_constant);
+  }
+}
+
+// The pixels of a batch of tiles are rendered one bounce at a time instead of one pixel at a time. Every ray of a
+// bounce waits in a queue for its kind, and each queue is traced and shaded as a whole before the next bounce begins.
+// Once every bounce is done, the vertices are finished in reverse, so each one's rays are finished before it is.
+void render_wavefront (Wavefront &wavefront, const int *tiles, int count, Camera &camera,
+                       Accelerator *accelerator, Light_tree *light_tree, Properties *properties, Render_state *state,
+                       vector<float> &pixels) {
+  for (int type = 0; type < 3; type++) {
+    wavefront.queues[type].clear();
+  }
+  wavefront.vertices.clear();
+
+  // Camera rays are queued in square packets of neighboring pixels, just as the recursive engine traces them.
+  for (int t = 0; t < count; t++) {
+    int first_i, first_j, last_i, last_j;
+    tile_bounds(properties, tiles[t], first_i, first_j, last_i, last_j);
+    for (int j = first_j; j < last_j; j += PACKET_WIDTH) {
+      for (int i = first_i; i < last_i; i += PACKET_WIDTH) {
+        for (int lane = 0; lane < PACKET_SIZE; lane++) {
+          int pixel_i = i + lane % PACKET_WIDTH;
+          int pixel_j = j + lane / PACKET_WIDTH;
+          if (pixel_i < last_i && pixel_j < last_j) {
+            int pixel_index = pixel_i + pixel_j*properties->imsize[0];
+            wavefront.queues[WAVE_CAMERA].push_back(Wave_ray{camera_ray(camera, pixel_i, pixel_j),
+                                                             Refraction_stack(properties->refraction_index),
+                                                             1, -1, pixel_index, 1});
+          }
+        }
+      }
+    }
+  }
+
+  for (int depth = 0; depth <= MAX_DEPTH; depth++) {
+    int first_vertex = (int)wavefront.vertices.size();
+    wavefront.next_queues[WAVE_REFLECTION].clear();
+    wavefront.next_queues[WAVE_TRANSMISSION].clear();
+    if (depth == 0) {
+      trace_queue(wavefront, WAVE_CAMERA, depth, accelerator, properties, state, pixels);
+    }
+    else {
+      trace_queue(wavefront, WAVE_REFLECTION, depth, accelerator, properties, state, pixels);
+      trace_queue(wavefront, WAVE_TRANSMISSION, depth, accelerator, properties, state, pixels);
+    }
+    shade_vertices(wavefront, first_vertex, accelerator, light_tree, properties, state);
+
+    wavefront.queues[WAVE_REFLECTION].swap(wavefront.next_queues[WAVE_REFLECTION]);
+    wavefront.queues[WAVE_TRANSMISSION].swap(wavefront.next_queues[WAVE_TRANSMISSION]);
+    if (wavefront.queues[WAVE_REFLECTION].empty() && wavefront.queues[WAVE_TRANSMISSION].empty()) {
+      break;
+    }
+  }
+
+  // A vertex's rays always come after it, so walking backward finishes every ray's color before it is needed.
+  for (int v = (int)wavefront.vertices.size() - 1; v >= 0; v--) {
+    Path_vertex &vertex = wavefront.vertices[v];
+    float own[3];
+    own_light(vertex.target, vertex.color, vertex.light_sum, own);
+    Color color;
+    if (vertex.traces_rays) {
+      color = blend_colors(own, vertex.reflection_weight, vertex.reflected, vertex.transmission_weight, vertex.transmitted);
+    }
+    else {
+      color = clamp_color(own);
+    }
+    if (vertex.parent == -1) {
+      pixels[3*(size_t)vertex.pixel] = color.r;
+      pixels[3*(size_t)vertex.pixel + 1] = color.g;
+      pixels[3*(size_t)vertex.pixel + 2] = color.b;
+    }
+    else {
+      slot_color(wavefront.vertices[vertex.parent], vertex.type) = color;
+    }
+  }
+}
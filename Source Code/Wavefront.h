@@ -0,0 +1,90 @@
+#ifndef WAVEFRONT_H_
+#define WAVEFRONT_H_
+
+#include <cstdlib>
+#include <vector>
+#include <utility>
+
+#include "Vectors.h"
+#include "Casting.h"
+#include "Properties.h"
+#include "Accelerators.h"
+#include "Render.h"
+
+using namespace std;
+
+// These resolve cyclical includes.
+class Object;
+class Light_tree;
+class Accelerator;
+struct Properties;
+
+// These macros control how the wavefront engine batches its rays.
+#define WAVEFRONT_TILES 4  // Each thread traces the rays of this many tiles together, one bounce at a time.
+#define WAVEFRONT_SORT_BITS 10  // Queued rays are sorted by their origins' cells in a grid with 2^this many cells on each axis.
+#define WAVEFRONT_MIN_THROUGHPUT 0  // Rays that can add no more than this to their pixel are dropped. At 0, only rays that
+                                    // add nothing are dropped, and images match the recursive engine's.
+
+// These name the queues that rays wait in, which are also the slots of the point that a ray left from.
+#define WAVE_REFLECTION 0
+#define WAVE_TRANSMISSION 1
+#define WAVE_CAMERA 2
+
+// This is a ray waiting to be traced, along with everything needed to shade whatever it hits.
+struct Wave_ray {
+  Ray ray;
+  Refraction_stack refraction_indices;
+  float throughput;  // This is the product of the Fresnel and opacity weights of every point along the ray's path.
+  int parent;  // This is the path vertex that the ray left from, which is -1 for camera rays.
+  int pixel;
+  unsigned int path;  // This is the path of the ray's random key.
+};
+
+// Every hit becomes a path vertex, which keeps what is needed to finish its color once its own rays have been shaded.
+// A vertex's reflected and transmitted colors start out black, and are filled in by the rays that it sends out.
+struct Path_vertex {
+  Object *target;
+  Intersection hit;
+  Vec3 view;  // This is the unit vector from the hit toward the eye.
+  float color[3];
+  float light_sum[3];
+  float reflection_weight;
+  float transmission_weight;
+  Color reflected;
+  Color transmitted;
+  bool traces_rays;  // This is false for vertices at the maximum depth, whose colors are only their own light.
+  int parent;
+  int type;  // This is the queue that the vertex's ray came from.
+  int pixel;
+  unsigned int path;
+};
+
+// This asks how much of one light reaches one path vertex. Its shadow rays are stored together in the shadow queue.
+struct Light_request {
+  int vertex;
+  int light;
+  float weight;
+  float ray_passes;  // This starts as the number of rays that need no tracing, such as those outside of a spotlight's cone.
+  int first_ray;
+  int ray_count;
+};
+
+// Each thread's render state keeps one of these, so that the queues' memory is reused from one batch and frame to the next.
+struct Wavefront {
+  vector<Wave_ray> queues[3];
+  vector<Wave_ray> next_queues[2];
+  vector<Path_vertex> vertices;
+  vector<Light_request> requests;
+  vector<Ray> shadow_rays;
+  vector<float> shadow_distances;
+  vector<float> shadow_passes;
+  vector<pair<unsigned long long, int> > order;  // This holds the sort key and index of every ray in the queue being traced.
+  vector<Ray> sorted_rays;  // These hold one light's shadow rays in sorted order while they are traced.
+  vector<float> sorted_distances;
+  vector<float> sorted_passes;
+};
+
+void render_wavefront(Wavefront &wavefront, const int *tiles, int count, Camera &camera, Accelerator *accelerator,
+                      Light_tree *light_tree, Properties *properties, Render_state *state, vector<float> &pixels);
+
+#endif
@@ -1,248 +1,655 @@
-#include <cstdio>
-#include <cstdlib>
-#include <cmath>
-#include <vector>
-#include <cstring>
-
-#include "Objects.h"
-#include "Lights.h"
-#include "Vectors.h"
-#include "Casting.h"
-#include "Properties.h"
-
-using namespace std;
-
-
-int main (int argc, char *argv[]) {
-
-  if (argc != 2) { //The caster first checks if a file was provided or not.
-    printf("Please provide the path and name of your properties file as a command line argument.\n");
-    return 1;
-  }
-
-  FILE *file_ptr = fopen(argv[1], "r");
-  if (file_ptr == NULL) { //The user is notified if their file couldn't be opened.
-    printf("Sorry, the file that you provided could not be opened.\n");
-    printf("Please check your file's name/directory and try again.\n");
-    return 1;
-  }
-
-  int failure_test;
-
-  //The image information is extracted into appropriate structs from the file.
-  Properties *properties = new Properties;
-  vector <Object*> objects;
-  vector <Light*> lights;
-  vector <Material*> materials;
-  vector<Texture*> textures;
-  vector <Vertex*> vertices;
-  vector <Normal*> normals;
-  vector <T_coord*> t_coords;
-
-  printf("Scanning your file now...\n\n");
-  failure_test = extract_info(file_ptr, properties, objects, lights, materials, textures, vertices, normals, t_coords);
-  if (failure_test) {
-    fclose(file_ptr);
-    delete properties;
-    delete_materials(materials);
-    delete_textures(textures);
-    delete_vertices(vertices);
-    delete_normals(normals);
-    delete_t_coords(t_coords);
-    return 1;
-  }
-
-  printf("\nYour file was scanned successfully!\n");
-  printf("A .ppm file is being generated from the scan, please wait...\n\n");
-
-  //Pi is used to convert degrees to radians for tan().
-  const float pi = 4.0 * atan(1.0);
-
-  float d = 2; //d is defined arbitrarily here.
-  float h = 2*d*tan((properties->vfov)*pi/360);
-  float w = h*(properties->imsize[0])/(properties->imsize[1]);
-
-  Vector *eye = new_vector(0, 0, 0, properties->eye[0], properties->eye[1], properties->eye[2]);
-  Vector *viewdir = new_vector(0, 0, 0, properties->viewdir[0], properties->viewdir[1], properties->viewdir[2]);
-  unit_vector(viewdir);
-  Vector *updir = new_vector(0, 0, 0, properties->updir[0], properties->updir[1], properties->updir[2]);
-  unit_vector(updir);
-
-  Vector *u = cross_product(viewdir, updir);
-  unit_vector(u);
-
-  Vector *v = cross_product(u, viewdir);
-  unit_vector(v);
-
-  Vector *n = copy_vector(viewdir);
-
-  scale_vector(n, d); //n = n*d
-  scale_vector(u, w/2); //u = u*(w/2)
-  scale_vector(v, h/2); //v = v*(h/2)
-
-  //Once the dimension vectors are defined, the structure of the viewing window is built.
-  Vector *ul = add_vectors(eye, n);
-  Vector *ul_subtraction = subtract_vectors(ul, u);
-  Vector *ul_addition = add_vectors(ul_subtraction, v);
-  delete ul;
-  delete ul_subtraction;
-  ul = ul_addition;
-
-  Vector *ur = add_vectors(eye, n);
-  Vector *ur_addition1 = add_vectors(ur, u);
-  Vector *ur_addition2 = add_vectors(ur_addition1, v);
-  delete ur;
-  delete ur_addition1;
-  ur = ur_addition2;
-
-  Vector *ll = add_vectors(eye, n);
-  Vector *ll_subtraction1 = subtract_vectors(ll, u);
-  Vector *ll_subtraction2 = subtract_vectors(ll_subtraction1, v);
-  delete ll;
-  delete ll_subtraction1;
-  ll = ll_subtraction2;
-
-  Vector *lr = add_vectors(eye, n);
-  Vector *lr_addition = add_vectors(lr, u);
-  Vector *lr_subtraction = subtract_vectors(lr_addition, v);
-  delete lr;
-  delete lr_addition;
-  lr = lr_subtraction;
-
-  Vector *hc_change = subtract_vectors(ur, ul);
-  scale_vector(hc_change, 1.0/(2.0*properties->imsize[0]));
-
-  Vector *vc_change = subtract_vectors(ll, ul);
-  scale_vector(vc_change, 1.0/(2.0*properties->imsize[1]));
-
-  Vector *h_change = copy_vector(hc_change);
-  scale_vector(h_change, 2);
-
-  Vector *v_change = copy_vector(vc_change);
-  scale_vector(v_change, 2);
-
-  delete viewdir;
-  delete updir;
-  delete u;
-  delete v;
-  delete n;
-  delete ur;
-  delete ll;
-  delete lr;
-
-  //A 2D array is allocated for the pixel colors.
-  int pixel_num = properties->imsize[0]*properties->imsize[1];
-  int **pixels = new int*[pixel_num];
-  for (int i=0; i < pixel_num; i++) {
-    pixels[i] = new int[3];
-  }
-
-  //For each pixel, a ray is drawn and used to test for object intersections.
-  for (int j=0; j<properties->imsize[1]; j++) {
-    for (int i=0; i<properties->imsize[0]; i++) {
-      int pixel_index = i+j*(properties->imsize[0]); //This is used to index the array.
-
-      Vector *h_change_copy = copy_vector(h_change);
-      scale_vector(h_change_copy, i);
-      Vector *v_change_copy = copy_vector(v_change);
-      scale_vector(v_change_copy, j);
-
-      Vector *window_point = add_vectors(ul, h_change_copy);
-      Vector *addition1 = add_vectors(window_point, v_change_copy);
-      Vector *addition2 = add_vectors(addition1, hc_change);
-      Vector *addition3 = add_vectors(addition2, vc_change);
-      delete window_point;
-      delete addition1;
-      delete addition2;
-      delete h_change_copy;
-      delete v_change_copy;
-      window_point = addition3;
-
-      Vector *ray_direction = subtract_vectors(window_point, eye);
-      ray_direction->x = properties->eye[0];
-      ray_direction->y = properties->eye[1];
-      ray_direction->z = properties->eye[2];
-      delete window_point;
-      unit_vector(ray_direction);
-      //Once the ray is created, each object is checked to find the closest intersection.
-      Object *contact = closest_intersection(objects, ray_direction);
-
-      // This vector will be used as a stack to hold the scene's indices of refraction.
-      vector<float> refraction_indices;
-      refraction_indices.push_back(properties->refraction_index);
-
-      //Once an intersection is or isn't found, the current pixel is colored accordingly.
-      color_pixel(contact, ray_direction, objects, lights, properties, pixels, pixel_index, refraction_indices, 0);
-      delete ray_direction;
-    }
-  }
-
-  delete eye;
-  delete ul;
-  delete hc_change;
-  delete vc_change;
-  delete h_change;
-  delete v_change;
-
-  //The objects and are freed once the pixels are colored.
-  delete_materials(materials);
-  delete_textures(textures);
-  delete_vertices(vertices);
-  delete_normals(normals);
-  delete_t_coords(t_coords);
-
-  //The name for the .ppm file is copied from the original file.
-  char *file_name = argv[1];
-  size_t txt_len = strlen(file_name);
-  size_t name_end = 0;
-  for (unsigned int i = 0; i < txt_len; i++) {
-    if (file_name[i] == '.') {
-      name_end = i;
-    }
-  }
-  if (name_end <= 0) {
-    printf("Sorry, the name of your original file could not be recovered for a .ppm file.\n");
-    fclose(file_ptr);
-    delete properties;
-    delete_pixels(pixels, pixel_num);
-    return 1;
-  }
-  char ppm_name[name_end+6]; //+4 for .ppm, +1 for \0, and +1 for the index offset.
-  strncpy(ppm_name, file_name, name_end);
-  ppm_name[name_end] = '\0';
-  strcat(ppm_name, ".ppm");
-
-  //The original file is closed.
-  fclose(file_ptr);
-
-  //A .ppm file with the same name as the original file is created.
-  FILE *ppm_ptr = fopen(ppm_name, "w");
-  if (ppm_ptr == NULL) {
-    printf("Sorry, the .ppm file could not be created/opened.\n");
-    delete properties;
-    delete_pixels(pixels, pixel_num);
-    return 1;
-  }
-
-  //The data for the .ppm file is added to the beginning of the file.
-  fprintf(ppm_ptr, "P3\n#Resolution:\n%d %d\n#Maximum Color Value:\n255\n\n", properties->imsize[0], properties->imsize[1]);
-
-  printf("The parameters for your .ppm file have been generated and are shown below: \n\n");
-  printf("P3\n#Resolution:\n%d %d\n#Maximum Color Value:\n255\n\n", properties->imsize[0], properties->imsize[1]);
-  printf("Coloring the pixels now...\n\n");
-
-  //Once the image properties are copied down, the pixels color values are added.
-  for (int i=0; i<properties->imsize[0]*properties->imsize[1]; i++) {
-    fprintf(ppm_ptr, "%d %d %d\n", pixels[i][0], pixels[i][1], pixels[i][2]);
-  }
-
-  printf("Your .ppm file has been created!\n");
-
-  //Before the program ends, the properties struct and the pixel array are de-allocated.
-  delete properties;
-  delete_pixels(pixels, pixel_num);
-
-  //The .ppm file is closed before the program ends.
-  fclose(ppm_ptr);
-  return 0;
-}
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+
+#include <unistd.h>
+
+#include "Objects.h"
+#include "Lights.h"
+#include "Vectors.h"
+#include "Casting.h"
+#include "Properties.h"
+#include "Accelerators.h"
+#include "Arena.h"
+#include "Render.h"
+#include "Wavefront.h"
+#include "Distributed.h"
+#include "Daemon.h"
+
+using namespace std;
+
+// This function converts a color value between 0 and 1 into the .ppm file's range of 0 to 255.
+static int quantize (float value) {
+  return (int)(255*value);
+}
+
+// This function writes the colored pixels to a .ppm file and returns 1 if the file couldn't be created.
+// The framebuffer holds three floats per pixel in row order, which are only rounded to integers here.
+static int write_ppm (char *ppm_name, Properties *properties, vector<float> &pixels) {
+  FILE *ppm_ptr = fopen(ppm_name, "w");
+  if (ppm_ptr == NULL) {
+    printf("Sorry, the .ppm file could not be created/opened.\n");
+    return 1;
+  }
+
+  //The data for the .ppm file is added to the beginning of the file.
+  fprintf(ppm_ptr, "P3\n#Resolution:\n%d %d\n#Maximum Color Value:\n255\n\n", properties->imsize[0], properties->imsize[1]);
+
+  //Once the image properties are copied down, the pixels color values are added.
+  for (int i=0; i<properties->imsize[0]*properties->imsize[1]; i++) {
+    fprintf(ppm_ptr, "%d %d %d\n", quantize(pixels[3*i]), quantize(pixels[3*i + 1]), quantize(pixels[3*i + 2]));
+  }
+
+  fclose(ppm_ptr);
+  return 0;
+}
+
+// This function assembles one frame from the tiles in every partial image, and returns 1 if any tile is missing.
+static int merge_frame (vector<char*> &part_names, Properties *properties, int frame, vector<float> &pixels) {
+  vector<bool> done(tile_count(properties), false);
+  for (unsigned int i = 0; i < part_names.size(); i++) {
+    if (read_partial(part_names[i], properties, frame, pixels, done) < 0) {
+      return 1;
+    }
+  }
+  for (unsigned int tile = 0; tile < done.size(); tile++) {
+    if (!done[tile]) {
+      printf("Sorry, tile %d of frame %d is missing from the partial images.\n", tile, frame);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// This function returns where the extension of the scene file's name starts, or 0 if it has none.
+static size_t find_name_end (char *file_name) {
+  size_t txt_len = strlen(file_name);
+  size_t name_end = 0;
+  for (unsigned int i = 0; i < txt_len; i++) {
+    if (file_name[i] == '.') {
+      name_end = i;
+    }
+  }
+  return name_end;
+}
+
+// This function returns how many bytes frame_name() needs: the name, an underscore and the digits of the last frame,
+// .ppm, and \0. Frame numbers are padded to at least 4 digits.
+static size_t frame_name_size (size_t name_end, int frames) {
+  int digits = 4;
+  for (int last = frames - 1; last >= 10000; last /= 10) {
+    digits++;
+  }
+  return name_end + 1 + digits + 5;
+}
+
+// This function names the .ppm file of a frame after the scene file. Animations add the frame number to each file's name.
+static void frame_name (char *ppm_name, char *file_name, size_t name_end, int frames, int frame) {
+  size_t size = frame_name_size(name_end, frames);
+  strncpy(ppm_name, file_name, name_end);
+  if (frames > 1) {
+    snprintf(ppm_name + name_end, size - name_end, "_%04d.ppm", frame);
+  }
+  else {
+    snprintf(ppm_name + name_end, size - name_end, ".ppm");
+  }
+}
+
+// This function prints the ways that the ray tracer can be run.
+static void print_usage () {
+  printf("Usage: ray_tracer [--accel bvh|grid] [--engine recursive|wavefront] [--threads n] [--verbose]\n");
+  printf("                  [--serve port | --worker host:port | --tiles list] filepath\n");
+  printf("       ray_tracer --merge filepath partfiles...\n");
+  printf("       ray_tracer [--threads n] --daemon socketpath\n");
+  printf("       ray_tracer --submit socketpath [--priority n] [--set \"property values\"]... filepath\n");
+  printf("       ray_tracer --submit socketpath --cancel job\n");
+}
+
+// This function returns whether a command line option is followed by a value.
+static bool takes_value (const char *option) {
+  const char *options[] = {"--accel", "--engine", "--threads", "--serve", "--worker", "--tiles", "--daemon", "--submit",
+                           "--set", "--priority", "--cancel"};
+  for (size_t i = 0; i < sizeof(options)/sizeof(options[0]); i++) {
+    if (strcmp(option, options[i]) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// This function hands a scene to a render daemon, and writes each frame's .ppm file once every tile of it has been
+// streamed back. With a job number to cancel, it asks the daemon to cancel that job instead. It returns 1 if the job
+// failed or was cancelled.
+static int submit_job (const char *socket_path, char *file_name, vector<char> &overrides, int priority, int cancel) {
+  size_t name_end = 0;
+  if (cancel < 0) {
+    name_end = find_name_end(file_name);
+    if (name_end <= 0) {
+      printf("Sorry, the name of your original file could not be recovered for a .ppm file.\n");
+      return 1;
+    }
+  }
+  int socket = connect_daemon(socket_path);
+  if (socket == -1) {
+    return 1;
+  }
+  if (cancel >= 0 ? !send_cancel(socket, cancel) : !send_job(socket, file_name, overrides, priority)) {
+    printf("Sorry, the render daemon could not be reached.\n");
+    close(socket);
+    return 1;
+  }
+
+  Properties properties;
+  bool started = false;
+  vector<float> pixels;
+  vector<bool> done;
+  vector<char> ppm_name;
+  vector<char> body;
+  while (receive_message(socket, body)) {
+    int kind = get_int(&body[0], 0);
+    if (kind == MESSAGE_QUEUED && body.size() == 2*sizeof(int)) {
+      printf("Your scene is job %d in the render daemon's queue.\n\n", get_int(&body[0], 4));
+      fflush(stdout);
+    }
+    else if (kind == MESSAGE_STARTED && body.size() == 5*sizeof(int)) {
+      properties.imsize[0] = get_int(&body[0], 8);
+      properties.imsize[1] = get_int(&body[0], 12);
+      properties.frames = get_int(&body[0], 16);
+      ppm_name.resize(frame_name_size(name_end, properties.frames));
+      pixels.assign(3*(size_t)properties.imsize[0]*properties.imsize[1], 0);
+      done.assign(tile_count(&properties), false);
+      started = true;
+      printf("P3\n#Resolution:\n%d %d\n#Maximum Color Value:\n255\n\n", properties.imsize[0], properties.imsize[1]);
+      printf("Coloring the pixels now...\n\n");
+    }
+    else if (kind == MESSAGE_PIXELS && started) {
+      copy_tile(&body[0], body.size(), &properties, pixels, done);
+    }
+    else if (kind == MESSAGE_FRAME && started && body.size() == 2*sizeof(int)) {
+      frame_name(&ppm_name[0], file_name, name_end, properties.frames, get_int(&body[0], 4));
+      if (write_ppm(&ppm_name[0], &properties, pixels)) {
+        close(socket);
+        return 1;
+      }
+      done.assign(done.size(), false);
+    }
+    else if (kind == MESSAGE_FINISHED && body.size() > 3*sizeof(int)) {
+      body.push_back('\0');
+      printf("%s\n", &body[3*sizeof(int)]);
+      close(socket);
+      return get_int(&body[0], 8) == JOB_DONE ? 0 : 1;
+    }
+  }
+  printf("Sorry, the render daemon was lost before your job finished.\n");
+  close(socket);
+  return 1;
+}
+
+int main (int argc, char *argv[]) {
+
+  //Options may be given before the path of the properties file.
+  char *file_name = NULL;
+  int accelerator_choice = -1;
+  int engine_choice = -1;
+  bool verbose = false;
+  int thread_choice = 0;
+  const char *serve_port = NULL;
+  const char *worker_address = NULL;
+  const char *tile_spec = NULL;
+  bool merge = false;
+  vector<char*> part_names;
+  vector<int> tile_list;
+  const char *daemon_path = NULL;
+  const char *submit_path = NULL;
+  vector<char> overrides;
+  int priority = 0;
+  int cancel = -1;
+  for (int i = 1; i < argc; i++) {
+    if (takes_value(argv[i]) && i + 1 == argc) {
+      printf("The option \"%s\" needs a value after it.\n", argv[i]);
+      print_usage();
+      return 1;
+    }
+    if (strcmp(argv[i], "--accel") == 0) {
+      i++;
+      if (strcmp(argv[i], "bvh") == 0) {
+        accelerator_choice = ACCEL_BVH;
+      }
+      else if (strcmp(argv[i], "grid") == 0) {
+        accelerator_choice = ACCEL_GRID;
+      }
+      else {
+        printf("The accelerator \"%s\" is not recognized. Please choose \"bvh\" or \"grid\".\n", argv[i]);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--engine") == 0) {
+      i++;
+      if (strcmp(argv[i], "recursive") == 0) {
+        engine_choice = ENGINE_RECURSIVE;
+      }
+      else if (strcmp(argv[i], "wavefront") == 0) {
+        engine_choice = ENGINE_WAVEFRONT;
+      }
+      else {
+        printf("The engine \"%s\" is not recognized. Please choose \"recursive\" or \"wavefront\".\n", argv[i]);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--threads") == 0) {
+      i++;
+      thread_choice = atoi(argv[i]);
+      if (thread_choice <= 0) {
+        printf("The thread count \"%s\" is not valid. Please choose a positive number.\n", argv[i]);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--serve") == 0) {
+      serve_port = argv[++i];
+    }
+    else if (strcmp(argv[i], "--worker") == 0) {
+      worker_address = argv[++i];
+    }
+    else if (strcmp(argv[i], "--tiles") == 0) {
+      tile_spec = argv[++i];
+      if (!parse_tile_list(tile_spec, tile_list)) {
+        printf("The tile list \"%s\" is not recognized. Please give tiles and ranges such as \"0-99,120\".\n", tile_spec);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--merge") == 0) {
+      merge = true;
+    }
+    else if (strcmp(argv[i], "--daemon") == 0) {
+      daemon_path = argv[++i];
+    }
+    else if (strcmp(argv[i], "--submit") == 0) {
+      submit_path = argv[++i];
+    }
+    else if (strcmp(argv[i], "--set") == 0) { //Each override is a line of a scene file.
+      i++;
+      overrides.insert(overrides.end(), argv[i], argv[i] + strlen(argv[i]));
+      overrides.push_back('\n');
+    }
+    else if (strcmp(argv[i], "--priority") == 0) {
+      priority = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--cancel") == 0) {
+      i++;
+      cancel = atoi(argv[i]);
+      if (cancel <= 0) {
+        printf("The job number \"%s\" is not valid. Please choose a positive number.\n", argv[i]);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--verbose") == 0 || strcmp(argv[i], "-v") == 0) {
+      verbose = true;
+    }
+    else if (file_name == NULL) {
+      file_name = argv[i];
+    }
+    else if (merge) { //When merging, the partial images follow the properties file.
+      part_names.push_back(argv[i]);
+    }
+    else {
+      file_name = NULL;
+      break;
+    }
+  }
+
+  //A daemon and a cancellation are the only modes that don't need a properties file.
+  bool needs_file = daemon_path == NULL && cancel < 0;
+  if ((needs_file && file_name == NULL) || (!needs_file && file_name != NULL) || (merge && part_names.empty())) {
+    printf("Please provide the path and name of your properties file as a command line argument.\n");
+    print_usage();
+    return 1;
+  }
+  if ((serve_port != NULL) + (worker_address != NULL) + (tile_spec != NULL) + merge + (daemon_path != NULL) +
+      (submit_path != NULL) > 1) {
+    printf("Please choose only one of --serve, --worker, --tiles, --merge, --daemon, and --submit.\n");
+    return 1;
+  }
+  if ((cancel >= 0 || !overrides.empty() || priority != 0) && submit_path == NULL) {
+    printf("Jobs can only be given overrides and priorities, or cancelled, with --submit.\n");
+    return 1;
+  }
+
+  //A daemon keeps scenes between jobs, so it scans each scene when a job first asks for it.
+  if (daemon_path != NULL) {
+    return run_daemon(daemon_path, thread_choice);
+  }
+
+  //A submitted scene is scanned and rendered by the daemon. The accelerator and engine chosen on the command line
+  //are passed along with the other overrides.
+  if (submit_path != NULL) {
+    if (accelerator_choice != -1) {
+      const char *line = accelerator_choice == ACCEL_GRID ? "accel grid\n" : "accel bvh\n";
+      overrides.insert(overrides.end(), line, line + strlen(line));
+    }
+    if (engine_choice != -1) {
+      const char *line = engine_choice == ENGINE_WAVEFRONT ? "engine wavefront\n" : "engine recursive\n";
+      overrides.insert(overrides.end(), line, line + strlen(line));
+    }
+    return submit_job(submit_path, file_name, overrides, priority, cancel);
+  }
+
+  FILE *file_ptr = fopen(file_name, "r");
+  if (file_ptr == NULL) { //The user is notified if their file couldn't be opened.
+    printf("Sorry, the file that you provided could not be opened.\n");
+    printf("Please check your file's name/directory and try again.\n");
+    return 1;
+  }
+
+  int failure_test;
+
+  //The image information is extracted into appropriate structs from the file.
+  Properties *properties = new Properties;
+  vector <Object*> objects;
+  vector <Light*> lights;
+  Arena arena;  // The objects, lights, materials, and textures are all freed together when this goes out of scope.
+  Triangle_store store;
+  vector <Mesh*> meshes;
+  vector <Motion> motions;
+
+  printf("Scanning your file now...\n\n");
+  chrono::steady_clock::time_point scan_start = chrono::steady_clock::now();
+  failure_test = extract_info(file_ptr, properties, objects, lights, arena, store, meshes, motions, NULL);
+  double scan_time = chrono::duration<double>(chrono::steady_clock::now() - scan_start).count();
+  if (failure_test) {
+    fclose(file_ptr);
+    delete properties;
+    delete_meshes(meshes);
+    return 1;
+  }
+
+  printf("\nYour file was scanned successfully!\n");
+
+  if (!tile_list.empty() && *max_element(tile_list.begin(), tile_list.end()) >= tile_count(properties)) {
+    printf("Sorry, this image only has tiles 0 to %d.\n", tile_count(properties) - 1);
+    fclose(file_ptr);
+    delete properties;
+    delete_meshes(meshes);
+    return 1;
+  }
+
+  //The name for the .ppm file is copied from the original file. Animations add the frame number to each file's name.
+  size_t name_end = find_name_end(file_name);
+  if (name_end <= 0) {
+    printf("Sorry, the name of your original file could not be recovered for a .ppm file.\n");
+    fclose(file_ptr);
+    delete properties;
+    return 1;
+  }
+  //Partial images have no frame number, but add a dot, the tile list, and .part instead.
+  vector<char> ppm_name(max(frame_name_size(name_end, properties->frames),
+                            tile_spec != NULL ? name_end + strlen(tile_spec) + 7 : 0));
+
+  //The original file is closed.
+  fclose(file_ptr);
+
+  //The objects are organized into an accelerator so that each ray only tests nearby objects.
+  //An accelerator chosen on the command line overrides the one chosen in the file.
+  if (accelerator_choice != -1) {
+    properties->accelerator = accelerator_choice;
+  }
+  if (engine_choice != -1) {
+    properties->engine = engine_choice;
+  }
+
+  //A coordinator only assembles the tiles that its workers render, and a merge only assembles partial images, so
+  //neither one needs an accelerator.
+  bool renders = serve_port == NULL && !merge;
+  Accelerator *accelerator = NULL;
+  double build_time = 0;
+  if (renders) {
+    chrono::steady_clock::time_point build_start = chrono::steady_clock::now();
+    accelerator = build_accelerator(objects, properties->accelerator);
+    build_time = chrono::duration<double>(chrono::steady_clock::now() - build_start).count();
+  }
+  printf("A .ppm file is being generated from the scan, please wait...\n\n");
+
+  //The viewing window is built from the eye and the view and up directions.
+  Camera camera;
+  setup_camera(properties, camera);
+
+  //One contiguous framebuffer holds the red, green, and blue values of every pixel.
+  int pixel_num = properties->imsize[0]*properties->imsize[1];
+  vector<float> pixels(3*(size_t)pixel_num);
+
+  printf("The parameters for your .ppm file have been generated and are shown below: \n\n");
+  printf("P3\n#Resolution:\n%d %d\n#Maximum Color Value:\n255\n\n", properties->imsize[0], properties->imsize[1]);
+  printf("Coloring the pixels now...\n\n");
+
+  //The lights are organized into a tree so that each point only shades the lights that can reach it.
+  Light_tree *light_tree = new Light_tree(lights);
+
+  //Each rendering thread keeps its own state, such as the lights' shadow caches, separately from the scene.
+  int threads = renders ? render_threads(thread_choice) : 0;
+  vector<Render_state> states(threads);
+  for (int t = 0; t < threads; t++) {
+    init_render_state(&states[t], lights);
+  }
+  Render_stats stats = {0, 0};
+  long tiles_stolen = 0;
+
+  //A coordinator waits for workers before the first frame, and more workers may join at any time after that.
+  Coordinator coordinator;
+  if (serve_port != NULL && !start_coordinator(coordinator, serve_port)) {
+    delete accelerator;
+    delete light_tree;
+    delete_meshes(meshes);
+    delete properties;
+    return 1;
+  }
+
+  double render_time = 0;
+  double update_time = 0;
+  int rebuilds = 0;
+  int failure = 0;
+  if (worker_address != NULL) {
+    int socket = connect_worker(worker_address, properties);
+    if (socket == -1) {
+      failure = 1;
+    }
+
+    //A worker renders whichever tiles it is handed until the coordinator runs out of them. Frames only move forward,
+    //so the animated objects are moved once for each frame that the worker passes.
+    int current = 0;
+    int frame;
+    bool finished = false;
+    while (!failure && next_tiles(socket, frame, tile_list, finished)) {
+      if (frame < current || frame >= properties->frames) {
+        printf("Sorry, the coordinator asked for frame %d, which this worker can't render.\n", frame);
+        failure = 1;
+        break;
+      }
+      chrono::steady_clock::time_point update_start = chrono::steady_clock::now();
+      for (; current < frame; current++) {
+        if (advance_frame(motions, store, meshes, accelerator)) {
+          rebuilds++;
+        }
+      }
+      update_time += chrono::duration<double>(chrono::steady_clock::now() - update_start).count();
+
+      chrono::steady_clock::time_point render_start = chrono::steady_clock::now();
+      render_tiles(camera, accelerator, light_tree, properties, frame, tile_list, states, pixels, stats);
+      tiles_stolen += stats.tiles_stolen;
+      render_time += chrono::duration<double>(chrono::steady_clock::now() - render_start).count();
+      if (!send_tiles(socket, properties, frame, tile_list, pixels)) {
+        break;
+      }
+    }
+    if (!failure && !finished) {
+      printf("Sorry, the connection to the coordinator was lost before every tile was handed out.\n");
+      failure = 1;
+    }
+    if (socket != -1) {
+      close(socket);
+    }
+  }
+
+  for (int frame = 0; worker_address == NULL && !failure && frame < properties->frames; frame++) {
+
+    //After the first frame, the animated objects are moved and the accelerators are refit around them.
+    //A hierarchy is only rebuilt once refitting has made it noticeably slower to traverse.
+    if (frame > 0 && renders) {
+      chrono::steady_clock::time_point update_start = chrono::steady_clock::now();
+      if (advance_frame(motions, store, meshes, accelerator)) {
+        rebuilds++;
+      }
+      update_time += chrono::duration<double>(chrono::steady_clock::now() - update_start).count();
+    }
+
+    chrono::steady_clock::time_point render_start = chrono::steady_clock::now();
+
+    //The frame's tiles are shared between the threads, which write their pixels straight into the framebuffer.
+    //A coordinator shares them between its workers instead, and a merge reads them from the partial images.
+    if (serve_port != NULL) {
+      gather_frame(coordinator, properties, frame, pixels);
+    }
+    else if (merge) {
+      failure = merge_frame(part_names, properties, frame, pixels);
+    }
+    else if (tile_spec != NULL) {
+      render_tiles(camera, accelerator, light_tree, properties, frame, tile_list, states, pixels, stats);
+    }
+    else {
+      render_frame(camera, accelerator, light_tree, properties, frame, states, pixels, stats);
+    }
+    tiles_stolen += stats.tiles_stolen;
+
+    render_time += chrono::duration<double>(chrono::steady_clock::now() - render_start).count();
+
+    //A .ppm file with the same name as the original file is created for each frame.
+    //Only some tiles are rendered with a tile list, so every frame's tiles are added to one partial image instead.
+    if (tile_spec != NULL) {
+      strncpy(&ppm_name[0], file_name, name_end);
+      snprintf(&ppm_name[name_end], ppm_name.size() - name_end, ".%s.part", tile_spec);
+      if (!write_partial(&ppm_name[0], properties, frame, tile_list, pixels)) {
+        failure = 1;
+      }
+      continue;
+    }
+    frame_name(&ppm_name[0], file_name, name_end, properties->frames, frame);
+    if (!failure && write_ppm(&ppm_name[0], properties, pixels)) {
+      failure = 1;
+    }
+  }
+  if (serve_port != NULL) {
+    stop_coordinator(coordinator);
+  }
+  if (failure) {
+    delete accelerator;
+    delete light_tree;
+    delete_meshes(meshes);
+    delete properties;
+    return 1;
+  }
+
+  //A coordinator reports how many workers were lost, and how much of their work had to be handed out again.
+  if (verbose && serve_port != NULL) {
+    printf("Coordinator: %.3f s to gather %d frame%s of %d tiles\n", render_time, properties->frames,
+           properties->frames == 1 ? "" : "s", tile_count(properties));
+    printf("Workers lost: %d, %ld tile%s handed out again\n\n", coordinator.workers_lost, coordinator.tiles_reassigned,
+           coordinator.tiles_reassigned == 1 ? "" : "s");
+  }
+
+  //The accelerator's build time and ray rate are reported so that the accelerators can be compared.
+  if (verbose && renders) {
+    //Each thread's counts are summed, and each light's shadow caches are merged into the first thread's.
+    Render_state &state = states[0];
+    for (int t = 1; t < threads; t++) {
+      state.closest_queries += states[t].closest_queries;
+      state.light_gathers += states[t].light_gathers;
+      state.lights_gathered += states[t].lights_gathered;
+      for (unsigned int i = 0; i < state.shadow_caches.size(); i++) {
+        state.shadow_caches[i].lookups += states[t].shadow_caches[i].lookups;
+        state.shadow_caches[i].hits += states[t].shadow_caches[i].hits;
+      }
+    }
+    long cache_hits = 0;
+    long lookups = 0;
+    for (unsigned int i = 0; i < state.shadow_caches.size(); i++) {
+      cache_hits += state.shadow_caches[i].hits;
+      lookups += state.shadow_caches[i].lookups;
+    }
+    long rays = state.closest_queries + lookups;
+    //Grids are always built on one thread, and so are hierarchies of small scenes.
+    int build_thread_count = 1;
+    if (properties->accelerator == ACCEL_GRID) {
+      Grid *grid = (Grid*)accelerator;
+      printf("Accelerator: grid with %d cells and %d object references\n", grid->cell_count(), grid->reference_count());
+    }
+    else {
+      BVH *bvh = (BVH*)accelerator;
+      printf("Accelerator: bounding volume hierarchy with %d nodes, collapsed into %d %d-wide nodes\n",
+             bvh->node_count(), bvh->wide_node_count(), BVH_WIDTH);
+      build_thread_count = bvh->build_thread_count();
+    }
+    size_t memory = accelerator->memory_usage();
+    for (vector<Mesh*>::iterator i = meshes.begin(); i != meshes.end(); ++i) {
+      memory += (*i)->bvh->memory_usage();
+    }
+    printf("Build time: %.3f ms for %d objects with %d thread%s\n", 1000*build_time, (int)objects.size(),
+           build_thread_count, build_thread_count == 1 ? "" : "s");
+    printf("Accelerator memory: %.2f MB\n", memory/(1024.0*1024.0));
+    printf("Scan time: %.3f ms\n", 1000*scan_time);
+    printf("Scene arena: %.2f MB in %ld allocations, %d block%s, %.2f MB high-water mark\n", arena.bytes_used()/(1024.0*1024.0),
+           arena.allocation_count(), arena.block_count(), arena.block_count() == 1 ? "" : "s", arena.high_water_mark()/(1024.0*1024.0));
+    if (properties->frames > 1) {
+      printf("Frames: %d (%d refit, %d rebuilt), %.3f ms of updates per frame\n", properties->frames,
+             properties->frames - 1 - rebuilds, rebuilds, 1000*update_time/(properties->frames - 1));
+    }
+    if (properties->engine == ENGINE_WAVEFRONT) {
+      printf("Engine: wavefront, in batches of %d tiles\n", WAVEFRONT_TILES);
+    }
+    else {
+      printf("Engine: recursive\n");
+    }
+    printf("Render time: %.3f s with %d thread%s\n", render_time, threads, threads == 1 ? "" : "s");
+    printf("Tiles: %d per frame of %dx%d pixels, %ld stolen from other threads\n", stats.tiles, TILE_SIZE, TILE_SIZE, tiles_stolen);
+    printf("Rays traced: %ld (%ld closest hit, %ld shadow, %ld of them answered by shadow caches)\n", rays,
+           state.closest_queries, lookups, cache_hits);
+    printf("Rays per second: %.0f\n", rays/render_time);
+    printf("Lights shaded per hit: %.2f of %d\n", state.light_gathers > 0 ? (double)state.lights_gathered/state.light_gathers : 0.0,
+           (int)lights.size());
+    printf("Shadow caches: %ld hits of %ld lookups (%.1f%%)\n", cache_hits, lookups, lookups > 0 ? 100.0*cache_hits/lookups : 0.0);
+    //Each light's hit rate is only listed for scenes with a few lights.
+    if (state.shadow_caches.size() <= 8) {
+      for (unsigned int i = 0; i < state.shadow_caches.size(); i++) {
+        Shadow_cache &cache = state.shadow_caches[i];
+        printf("  Light %d: %ld hits of %ld lookups (%.1f%%)\n", i + 1, cache.hits, cache.lookups,
+               cache.lookups > 0 ? 100.0*cache.hits/cache.lookups : 0.0);
+      }
+    }
+    printf("\n");
+  }
+
+  for (int t = 0; t < threads; t++) {
+    free_render_state(&states[t]);
+  }
+  delete accelerator;
+  delete light_tree;
+
+  //The meshes are freed once the pixels are colored, and everything in the arena is freed when main returns.
+  delete_meshes(meshes);
+
+  if (worker_address != NULL) {
+    printf("Every tile handed to this worker has been rendered!\n");
+  }
+  else if (tile_spec != NULL) {
+    printf("Your partial image has been created!\n");
+  }
+  else {
+    printf("Your .ppm file has been created!\n");
+  }
+
+  //Before the program ends, the properties struct and the pixel array are de-allocated.
+  delete properties;
+
+  return 0;
+}